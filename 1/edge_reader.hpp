@@ -0,0 +1,67 @@
+#ifndef EDGE_READER_HPP
+#define EDGE_READER_HPP
+
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+// Scan the next unsigned integer in [p, end), skipping anything that isn't a digit
+inline bool scanInt(const char *&p, const char *end, int &value)
+{
+    while (p < end && (unsigned)(*p - '0') > 9)
+        p++;
+    if (p == end)
+        return false;
+
+    int v = 0;
+    while (p < end && (unsigned)(*p - '0') <= 9)
+        v = v * 10 + (*p++ - '0');
+    value = v;
+    return true;
+}
+
+// Bulk reader for the "V E" + E lines of "src dest" input format.
+// A regular file (including a redirected stdin) is memory-mapped, anything
+// else is read in large blocks. Integers are scanned by hand; any non-digit
+// counts as a separator. Edges are 1-based in the input and handed out 0-based.
+class EdgeReader
+{
+    const char *data = nullptr; // Start of the input
+    const char *pos = nullptr;  // Parse cursor
+    const char *end = nullptr;
+    size_t mappedSize = 0;      // Non-zero when data is an mmap of the input
+    vector<char> buffer;        // Holds input that could not be mapped
+
+public:
+    EdgeReader() {}
+    ~EdgeReader();
+    EdgeReader(const EdgeReader &) = delete;
+    EdgeReader &operator=(const EdgeReader &) = delete;
+
+    // Map or slurp everything readable from fd
+    bool open(int fd);
+
+    bool next(int &value) { return scanInt(pos, end, value); }
+
+    bool readHeader(int &vertices, int &edges)
+    {
+        return next(vertices) && next(edges);
+    }
+
+    // Parse up to edges pairs straight into addEdge(src, dest); returns how many were read
+    template <typename AddEdge>
+    int forEachEdge(int edges, AddEdge addEdge)
+    {
+        int i = 0, src, dest;
+        for (; i < edges && next(src) && next(dest); i++)
+            addEdge(src - 1, dest - 1);
+        return i;
+    }
+
+    // Parse up to edges pairs into src/dest, splitting the text between threads
+    // at line boundaries (0 = every core). Returns how many were read.
+    int readEdges(int edges, vector<int> &src, vector<int> &dest, int threads = 0);
+};
+
+#endif // EDGE_READER_HPP
@@ -0,0 +1,1072 @@
+#include "graph.hpp"
+#include "parallel_scc.hpp"
+#include <iostream>
+#include <algorithm>
+
+bool parseEngine(const string &name, SCCEngine &engine)
+{
+    if (name.empty() || name == "kosaraju")
+        engine = SCCEngine::Kosaraju;
+    else if (name == "pearce" || name == "tarjan")
+        engine = SCCEngine::Pearce;
+    else if (name == "parallel")
+        engine = SCCEngine::Parallel;
+    else
+        return false;
+    return true;
+}
+
+// Worker pool shared by every parallel SCC request, sized to the machine
+static WorkerPool &sharedPool()
+{
+    static WorkerPool pool;
+    return pool;
+}
+
+Graph::Graph(int V, bool dedup)
+{
+    this->V = V;
+    this->dedup = dedup;
+    adj.resize(V);
+    radj.resize(V);
+    adjPos.resize(V);
+    radjPos.resize(V);
+}
+
+void Graph::addEdge(int v, int w)
+{
+    if (!insertEdge(v, w))
+        return;
+    version++;
+    cout << "Edge added from " << v + 1 << " to " << w + 1 << endl;
+}
+
+void Graph::removeEdge(int v, int w)
+{
+    if (!eraseEdge(v, w))
+        return;
+    version++;
+    cout << "Edge removed from " << v + 1 << " to " << w + 1 << endl;
+}
+
+void Graph::applyBatch(const vector<EdgeOp> &ops)
+{
+    // Repairing the live SCCs edge by edge only pays off for a short batch;
+    // after a long one the next query rebuilds them once
+    if (live && ops.size() > LIVE_BATCH)
+        dropLive({});
+
+    bool changed = false;
+    for (const EdgeOp &op : ops)
+    {
+        if (op.add)
+            changed |= insertEdge(op.v, op.w);
+        else
+            changed |= eraseEdge(op.v, op.w);
+    }
+    if (changed)
+        version++;
+    cout << "Batch of " << ops.size() << " operations applied" << endl;
+}
+
+void Graph::loadEdges(const vector<EdgeOp> &ops)
+{
+    bool changed = false;
+    for (const EdgeOp &op : ops)
+        changed |= insertEdge(op.v, op.w);
+    if (changed)
+        version++;
+}
+
+// Store v -> w without touching the version; false if dedup ignored it
+bool Graph::insertEdge(int v, int w)
+{
+    if (dedup && hasEdge(v, w))
+        return false;
+
+    // Each edge records where its twin sits in the other list, so removal never searches radj
+    adjPos[v].push_back((int)radj[w].size());
+    radjPos[w].push_back((int)adj[v].size());
+    adj[v].push_back(w);
+    radj[w].push_back(v);
+
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+        hub->second.emplace(w, (int)adj[v].size() - 1);
+    else if (adj[v].size() > HUB_DEGREE)
+        indexHub(v);
+    if (live)
+        insertEdgeLive(v, w);
+    return true;
+}
+
+// Drop every copy of v -> w without touching the version; false if there was none
+bool Graph::eraseEdge(int v, int w)
+{
+    // Slots in adj[v] holding a copy of the edge: a hash lookup for hubs, a short scan otherwise
+    vector<int> slots;
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+    {
+        auto range = hub->second.equal_range(w);
+        for (auto it = range.first; it != range.second; ++it)
+            slots.push_back(it->second);
+        hub->second.erase(range.first, range.second);
+    }
+    else
+    {
+        for (int i = 0; i < (int)adj[v].size(); i++)
+            if (adj[v][i] == w)
+                slots.push_back(i);
+    }
+    if (slots.empty())
+        return false;
+
+    // Highest slot first, so the edge moved into a freed slot is never another copy
+    sort(slots.begin(), slots.end(), greater<int>());
+    for (int i : slots)
+        unlinkEdge(v, i);
+    if (hub != hubIndex.end() && adj[v].size() < HUB_DEGREE / 2)
+        hubIndex.erase(hub);
+
+    // Only an edge inside a component can split it; the order stays topological either way
+    if (live && v != w && sccOf[v] == sccOf[w])
+        splitLive(sccOf[v]);
+    return true;
+}
+
+// Remove the edge in slot i of adj[v] and its twin in radj, each by moving the
+// last entry of its list into the hole. O(1) apart from a hub's multiplicity.
+void Graph::unlinkEdge(int v, int i)
+{
+    int w = adj[v][i], j = adjPos[v][i];
+
+    int last = (int)radj[w].size() - 1;
+    if (j != last)
+    {
+        int u = radj[w][last], k = radjPos[w][last];
+        radj[w][j] = u;
+        radjPos[w][j] = k;
+        adjPos[u][k] = j;
+    }
+    radj[w].pop_back();
+    radjPos[w].pop_back();
+
+    last = (int)adj[v].size() - 1;
+    if (i != last)
+    {
+        int x = adj[v][last], k = adjPos[v][last];
+        adj[v][i] = x;
+        adjPos[v][i] = k;
+        radjPos[x][k] = i;
+
+        auto hub = hubIndex.find(v);
+        if (hub != hubIndex.end())
+        {
+            auto range = hub->second.equal_range(x);
+            for (auto it = range.first; it != range.second; ++it)
+                if (it->second == last)
+                {
+                    it->second = i;
+                    break;
+                }
+        }
+    }
+    adj[v].pop_back();
+    adjPos[v].pop_back();
+}
+
+// Start indexing the out-edges of v, which just outgrew a linear scan
+void Graph::indexHub(int v)
+{
+    unordered_multimap<int, int> &index = hubIndex[v];
+    index.reserve(adj[v].size() * 2);
+    for (int i = 0; i < (int)adj[v].size(); i++)
+        index.emplace(adj[v][i], i);
+}
+
+// Whether v -> w is present, through the hub index or a scan of a short list
+bool Graph::hasEdge(int v, int w)
+{
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+        return hub->second.count(w) > 0;
+    return find(adj[v].begin(), adj[v].end(), w) != adj[v].end();
+}
+
+void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames)
+{
+    // Iterative so a long chain can't overflow the small proactor thread stacks
+    visited[v] = true;
+    frames.push_back({v, 0});
+
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)adj[top.first].size())
+        {
+            int i = adj[top.first][top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                frames.push_back({i, 0});
+            }
+        }
+        else
+        {
+            Deque.push_back(top.first);
+            frames.pop_back();
+        }
+    }
+}
+
+Graph Graph::getTranspose()
+{
+    // radj already holds the reversed edges, so this is just a copy with the roles swapped
+    Graph g(V, dedup);
+    g.adj = radj;
+    g.radj = adj;
+    g.adjPos = radjPos;
+    g.radjPos = adjPos;
+    for (int v = 0; v < V; v++)
+        if (g.adj[v].size() > HUB_DEGREE)
+            g.indexHub(v);
+    return g;
+}
+
+// Collect the vertices reachable from v in lists, in discovery order, into members
+void Graph::DFSUtil(const vector<vector<int>> &lists, int v, vector<bool> &visited, vector<int> &members, vector<pair<int, int>> &frames)
+{
+    visited[v] = true;
+    members.push_back(v);
+    frames.push_back({v, 0});
+
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)lists[top.first].size())
+        {
+            int i = lists[top.first][top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                members.push_back(i);
+                frames.push_back({i, 0});
+            }
+        }
+        else
+            frames.pop_back();
+    }
+}
+
+// One text line: the members, 1-based and space separated
+static void putComponent(OutputBuffer &out, const int *members, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        out.putInt(members[i] + 1);
+        out.put(' ');
+    }
+    out.put('\n');
+}
+
+// Kosaraju after a trim pass; every vertex gets an id in [0, count)
+int Graph::kosarajuSCC(vector<int> &comp)
+{
+    deque<int> Deque;
+    vector<pair<int, int>> frames; // DFS frames, reused by every traversal below
+    vector<bool> visited(V, false);
+    vector<int> members;
+
+    // Trivial SCCs never enter either DFS pass
+    int count = trim(comp);
+
+    for (int v = 0; v < V; v++)
+        visited[v] = comp[v] != -1;
+
+    for (int i = 0; i < V; i++)
+        if (!visited[i])
+            fillOrder(i, visited, Deque, frames);
+
+    for (int v = 0; v < V; v++)
+        visited[v] = comp[v] != -1;
+
+    while (!Deque.empty())
+    {
+        int v = Deque.back();
+        Deque.pop_back();
+        if (!visited[v])
+        {
+            members.clear();
+            DFSUtil(radj, v, visited, members, frames);
+            for (int w : members)
+                comp[w] = count;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+// Run one engine from scratch; every vertex gets an id in [0, count)
+int Graph::computeSCCs(SCCEngine engine, vector<int> &comp)
+{
+    if (engine == SCCEngine::Pearce)
+        return pearceSCC(comp);
+    if (engine == SCCEngine::Kosaraju)
+        return kosarajuSCC(comp);
+
+    vector<int> offsets, targets, rOffsets, rTargets;
+    int count = trim(comp);
+    toCSR(offsets, targets, false);
+    toCSR(rOffsets, rTargets, true);
+    return parallelSCC({V, offsets.data(), targets.data()},
+                       {V, rOffsets.data(), rTargets.data()}, comp, count, sharedPool());
+}
+
+// Width of the order slot every component starts with
+static const long long ORDER_GAP = 1 << 20;
+
+// Compute the SCCs from scratch and order them topologically (Kahn's
+// algorithm on the condensation), since not every engine numbers them in order
+void Graph::buildLive(SCCEngine engine)
+{
+    int count = computeSCCs(engine, sccOf);
+
+    sccMembers.assign(count, vector<int>());
+    for (int v = 0; v < V; v++)
+        sccMembers[sccOf[v]].push_back(v);
+
+    vector<int> inDeg(count, 0), queue;
+    liveBudget = V;
+    for (int v = 0; v < V; v++)
+    {
+        liveBudget += adj[v].size();
+        for (int w : adj[v])
+            if (sccOf[w] != sccOf[v])
+                inDeg[sccOf[w]]++;
+    }
+    for (int c = 0; c < count; c++)
+        if (inDeg[c] == 0)
+            queue.push_back(c);
+
+    sccOrd.assign(count, 0);
+    sccSpan.assign(count, ORDER_GAP);
+    for (size_t head = 0; head < queue.size(); head++)
+    {
+        int c = queue[head];
+        sccOrd[c] = (long long)head * ORDER_GAP;
+        for (int v : sccMembers[c])
+            for (int w : adj[v])
+                if (sccOf[w] != c && --inDeg[sccOf[w]] == 0)
+                    queue.push_back(sccOf[w]);
+    }
+
+    sccMark.assign(count, 0);
+    sccLocal.assign(V, 0);
+    live = true;
+}
+
+// Components reachable from 'from' over lists whose position lies in
+// [lower, upper]. Each one found is marked with bit and appended to found.
+// Scans are charged to liveBudget; returns false once it runs out.
+bool Graph::reachLive(int from, const vector<vector<int>> &lists, long long lower, long long upper, char bit, vector<int> &found)
+{
+    size_t first = found.size();
+    sccMark[from] |= bit;
+    found.push_back(from);
+    for (size_t i = first; i < found.size(); i++)
+        for (int v : sccMembers[found[i]])
+        {
+            liveBudget -= (long long)lists[v].size() + 1;
+            if (liveBudget < 0)
+                return false;
+            for (int w : lists[v])
+            {
+                int c = sccOf[w];
+                if (!(sccMark[c] & bit) && sccOrd[c] >= lower && sccOrd[c] <= upper)
+                {
+                    sccMark[c] |= bit;
+                    found.push_back(c);
+                }
+            }
+        }
+    return true;
+}
+
+// Give up on the live SCCs after an aborted search
+void Graph::dropLive(const vector<int> &marked)
+{
+    for (int c : marked)
+        sccMark[c] = 0;
+    live = false;
+}
+
+// Pearce-Kelly style insertion of v -> w. An edge inside one component or
+// along the current order changes nothing. Otherwise only the components
+// positioned between the two endpoints are searched: those reachable from w's
+// component (F) and those reaching v's (B). If they overlap, the edge closed a
+// cycle and F and B's common part merges into one component. The searched
+// components then take their old positions again, B before the merged one
+// before F, which keeps the order topological. Searches that together
+// would cost more than a rebuild drop the live SCCs instead.
+void Graph::insertEdgeLive(int v, int w)
+{
+    int cv = sccOf[v], cw = sccOf[w];
+    if (cv == cw || sccOrd[cv] < sccOrd[cw])
+        return;
+
+    long long lower = sccOrd[cw], upper = sccOrd[cv];
+    vector<int> affected;
+    if (!reachLive(cw, adj, lower, upper, 1, affected))
+    {
+        dropLive(affected);
+        return;
+    }
+    size_t forward = affected.size();
+    if (!reachLive(cv, radj, lower, upper, 2, affected))
+    {
+        dropLive(affected);
+        return;
+    }
+
+    // affected lists F, then B; a component in both was found twice
+    vector<pair<long long, long long>> slots;
+    vector<int> before, after, merged;
+    for (size_t i = 0; i < affected.size(); i++)
+    {
+        int c = affected[i];
+        if (sccMark[c] == 3)
+        {
+            if (i < forward)
+                merged.push_back(c);
+            continue;
+        }
+        (i < forward ? after : before).push_back(c);
+    }
+    for (int c : before)
+        slots.push_back({sccOrd[c], sccSpan[c]});
+    for (int c : after)
+        slots.push_back({sccOrd[c], sccSpan[c]});
+    for (int c : merged)
+        slots.push_back({sccOrd[c], sccSpan[c]});
+    sort(slots.begin(), slots.end());
+
+    auto byOrd = [&](int a, int b)
+    { return sccOrd[a] < sccOrd[b]; };
+    sort(before.begin(), before.end(), byOrd);
+    sort(after.begin(), after.end(), byOrd);
+
+    // Fold the cycle into its largest member component
+    if (!merged.empty())
+    {
+        int into = *max_element(merged.begin(), merged.end(), [&](int a, int b)
+                                { return sccMembers[a].size() < sccMembers[b].size(); });
+        for (int c : merged)
+        {
+            if (c == into)
+                continue;
+            for (int x : sccMembers[c])
+                sccOf[x] = into;
+            sccMembers[into].insert(sccMembers[into].end(), sccMembers[c].begin(), sccMembers[c].end());
+            vector<int>().swap(sccMembers[c]);
+        }
+        before.push_back(into);
+    }
+
+    // B (and the merged component) take the lowest slots, F the highest
+    auto place = [&](int c, const pair<long long, long long> &slot)
+    {
+        sccOrd[c] = slot.first;
+        sccSpan[c] = slot.second;
+    };
+    for (size_t i = 0; i < before.size(); i++)
+        place(before[i], slots[i]);
+    for (size_t i = 0; i < after.size(); i++)
+        place(after[i], slots[slots.size() - after.size() + i]);
+
+    for (int c : affected)
+        sccMark[c] = 0;
+}
+
+// Spread the live components evenly again once a slot is too narrow to split
+void Graph::renumberLive()
+{
+    vector<int> ids;
+    for (int c = 0; c < (int)sccMembers.size(); c++)
+        if (!sccMembers[c].empty())
+            ids.push_back(c);
+    sort(ids.begin(), ids.end(), [&](int a, int b)
+         { return sccOrd[a] < sccOrd[b]; });
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        sccOrd[ids[i]] = (long long)i * ORDER_GAP;
+        sccSpan[ids[i]] = ORDER_GAP;
+    }
+}
+
+// Tarjan restricted to the members of c, after an edge inside c was removed.
+// If c fell apart, the pieces become components of their own and share c's
+// slot in topological order. Work is proportional to c and its edges.
+void Graph::splitLive(int c)
+{
+    if (liveBudget < 0)
+    {
+        live = false;
+        return;
+    }
+
+    const vector<int> &members = sccMembers[c];
+    int n = (int)members.size();
+    for (int i = 0; i < n; i++)
+        sccLocal[members[i]] = i;
+
+    vector<int> index(n, 0), low(n), piece(n), S;
+    vector<char> onStack(n, 0);
+    vector<pair<int, int>> frames; // (local vertex, next position in its adj list)
+    int next = 1, pieces = 0;
+    long long scanned = n;
+
+    for (int s = 0; s < n; s++)
+    {
+        if (index[s] != 0)
+            continue;
+        index[s] = low[s] = next++;
+        S.push_back(s);
+        onStack[s] = 1;
+        frames.push_back({s, 0});
+
+        while (!frames.empty())
+        {
+            pair<int, int> &top = frames.back();
+            int x = top.first;
+            const vector<int> &out = adj[members[x]];
+            if (top.second < (int)out.size())
+            {
+                int y = out[top.second++];
+                scanned++;
+                if (sccOf[y] != c)
+                    continue;
+                int ly = sccLocal[y];
+                if (index[ly] == 0)
+                {
+                    index[ly] = low[ly] = next++;
+                    S.push_back(ly);
+                    onStack[ly] = 1;
+                    frames.push_back({ly, 0});
+                }
+                else if (onStack[ly])
+                {
+                    low[x] = min(low[x], index[ly]);
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if (low[x] == index[x])
+            {
+                int y;
+                do
+                {
+                    y = S.back();
+                    S.pop_back();
+                    onStack[y] = 0;
+                    piece[y] = pieces;
+                } while (y != x);
+                pieces++;
+            }
+            if (!frames.empty())
+            {
+                int parent = frames.back().first;
+                low[parent] = min(low[parent], low[x]);
+            }
+        }
+    }
+
+    liveBudget -= scanned;
+    if (pieces == 1)
+        return;
+
+    if (sccSpan[c] < pieces)
+        renumberLive();
+    if (sccSpan[c] < pieces)
+    {
+        live = false; // More pieces than any slot can hold; rebuild instead
+        return;
+    }
+
+    // Tarjan completes sinks first, so the last piece leads the order and keeps id c
+    vector<vector<int>> parts(pieces);
+    for (int i = 0; i < n; i++)
+        parts[pieces - 1 - piece[i]].push_back(members[i]);
+
+    long long base = sccOrd[c], span = sccSpan[c], step = span / pieces;
+    for (int r = 0; r < pieces; r++)
+    {
+        int id = c;
+        if (r > 0)
+        {
+            id = (int)sccMembers.size();
+            sccMembers.push_back(vector<int>());
+            sccOrd.push_back(0);
+            sccSpan.push_back(0);
+            sccMark.push_back(0);
+        }
+        for (int x : parts[r])
+            sccOf[x] = id;
+        sccMembers[id].swap(parts[r]);
+        sccOrd[id] = base + r * step;
+        sccSpan[id] = r == pieces - 1 ? span - (pieces - 1) * step : step;
+    }
+}
+
+// The SCCs of the current version, from the live components (rebuilt with
+// engine if they were dropped). Computed once per version.
+const SCCResult &Graph::sccs(SCCEngine engine)
+{
+    if (resultVersion == version)
+        return result;
+    if (!live)
+        buildLive(engine);
+
+    // Renumber the live components densely, highest id first in topological
+    // order, so printComponents lists them sources first like Kosaraju
+    vector<int> ids;
+    for (int c = 0; c < (int)sccMembers.size(); c++)
+        if (!sccMembers[c].empty())
+            ids.push_back(c);
+    sort(ids.begin(), ids.end(), [&](int a, int b)
+         { return sccOrd[a] < sccOrd[b]; });
+
+    int count = (int)ids.size();
+    result.comp.resize(V);
+    result.size.resize(count);
+    result.largest = -1;
+    for (int i = 0; i < count; i++)
+    {
+        int id = count - 1 - i;
+        for (int v : sccMembers[ids[i]])
+            result.comp[v] = id;
+        result.size[id] = (int)sccMembers[ids[i]].size();
+        if (result.largest < 0 || result.size[id] > result.size[result.largest])
+            result.largest = id;
+    }
+
+    resultVersion = version;
+    return result;
+}
+
+void Graph::printSCCs(OutputBuffer &out, SCCEngine engine, OutputFormat format)
+{
+    const SCCResult &r = sccs(engine);
+    if (format == OutputFormat::Text)
+        printComponents(r.comp, (int)r.size.size(), out);
+    else
+        writeComponents(out, format, r.comp, (int)r.size.size());
+}
+
+// Peel trivial SCCs before the heavy engines run. Trim-1 repeatedly assigns
+// vertices whose live in- or out-degree is 0; Trim-2 assigns 2-cycles with no
+// other live in-edges (or out-edges), then Trim-1 runs once more. In-edges
+// come from radj. Trimmed vertices get a component id in comp, the rest stay -1.
+// Returns the number of components found.
+int Graph::trim(vector<int> &comp)
+{
+    vector<int> inDeg(V), outDeg(V), queue;
+    int count = 0;
+
+    comp.assign(V, -1);
+    for (int v = 0; v < V; v++)
+    {
+        outDeg[v] = (int)adj[v].size();
+        inDeg[v] = (int)radj[v].size();
+        if (inDeg[v] == 0 || outDeg[v] == 0)
+            queue.push_back(v);
+    }
+
+    // Drop the edges of a just assigned vertex from its live neighbours' counters
+    auto detach = [&](int v)
+    {
+        for (int w : adj[v])
+            if (comp[w] == -1 && --inDeg[w] == 0)
+                queue.push_back(w);
+        for (int u : radj[v])
+            if (comp[u] == -1 && --outDeg[u] == 0)
+                queue.push_back(u);
+    };
+
+    auto trim1 = [&]()
+    {
+        while (!queue.empty())
+        {
+            int v = queue.back();
+            queue.pop_back();
+            if (comp[v] != -1)
+                continue;
+            comp[v] = count++;
+            detach(v);
+        }
+    };
+
+    // The single live neighbour in a list whose live degree is 1
+    auto onlyNeighbour = [&](const vector<int> &list)
+    {
+        for (int w : list)
+            if (comp[w] == -1)
+                return w;
+        return -1;
+    };
+
+    trim1();
+
+    for (int v = 0; v < V; v++)
+    {
+        if (comp[v] != -1)
+            continue;
+
+        int u = -1;
+        if (inDeg[v] == 1)
+        {
+            int w = onlyNeighbour(radj[v]);
+            if (w != v && inDeg[w] == 1 && onlyNeighbour(radj[w]) == v)
+                u = w;
+        }
+        if (u == -1 && outDeg[v] == 1)
+        {
+            int w = onlyNeighbour(adj[v]);
+            if (w != v && outDeg[w] == 1 && onlyNeighbour(adj[w]) == v)
+                u = w;
+        }
+        if (u == -1)
+            continue;
+
+        comp[v] = comp[u] = count++;
+        detach(v);
+        detach(u);
+    }
+
+    trim1();
+    return count;
+}
+
+// Pearce's space-efficient Tarjan: one DFS, rindex doubles as lowlink and
+// final component id, plus one root bit per vertex. Components are numbered
+// in the order they complete, i.e. reverse topological order.
+int Graph::pearceSCC(vector<int> &comp)
+{
+    vector<int> &rindex = comp;
+    vector<bool> root(V, false);
+    vector<int> S;                 // Visited vertices not yet assigned to an SCC
+    vector<pair<int, int>> frames; // (vertex, next edge index)
+    int index = 1;                 // 0 marks unvisited
+    int c = V - 1;                 // Next component id, counting down
+
+    rindex.assign(V, 0);
+    for (int s = 0; s < V; s++)
+    {
+        if (rindex[s] != 0)
+            continue;
+
+        rindex[s] = index++;
+        root[s] = true;
+        frames.push_back({s, 0});
+
+        while (!frames.empty())
+        {
+            pair<int, int> &top = frames.back();
+            int v = top.first;
+            if (top.second < (int)adj[v].size())
+            {
+                int w = adj[v][top.second++];
+                if (rindex[w] == 0)
+                {
+                    rindex[w] = index++;
+                    root[w] = true;
+                    frames.push_back({w, 0});
+                }
+                else if (rindex[w] < rindex[v])
+                {
+                    rindex[v] = rindex[w];
+                    root[v] = false;
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if (root[v])
+            {
+                // v is the root of a component: pop it and its members off S
+                index--;
+                while (!S.empty() && rindex[v] <= rindex[S.back()])
+                {
+                    rindex[S.back()] = c;
+                    S.pop_back();
+                    index--;
+                }
+                rindex[v] = c--;
+            }
+            else
+            {
+                S.push_back(v);
+            }
+
+            // Propagate the lowlink to the parent, as the recursive version does on return
+            if (!frames.empty())
+            {
+                int u = frames.back().first;
+                if (rindex[v] < rindex[u])
+                {
+                    rindex[u] = rindex[v];
+                    root[u] = false;
+                }
+            }
+        }
+    }
+
+    // Renumber so the first completed component is 0
+    for (int v = 0; v < V; v++)
+        comp[v] = V - 1 - rindex[v];
+    return V - 1 - c;
+}
+
+// Flatten adj, or radj for the transpose, into CSR arrays for the parallel engine
+void Graph::toCSR(vector<int> &offsets, vector<int> &targets, bool transpose)
+{
+    const vector<vector<int>> &lists = transpose ? radj : adj;
+
+    offsets.assign(V + 1, 0);
+    for (int v = 0; v < V; v++)
+        offsets[v + 1] = offsets[v] + (int)lists[v].size();
+
+    targets.resize(offsets[V]);
+    for (int v = 0; v < V; v++)
+        copy(lists[v].begin(), lists[v].end(), targets.begin() + offsets[v]);
+}
+
+shared_ptr<const OutputBuffer> Graph::sccResult(SCCEngine engine, OutputFormat format)
+{
+    shared_ptr<OutputBuffer> &slot = cached[(int)format];
+    if (slot && cachedVersion[(int)format] == version)
+        return slot;
+
+    // Refill the old buffer unless a sender still holds it
+    if (!slot || slot.use_count() > 1)
+        slot = make_shared<OutputBuffer>();
+    else
+        slot->clear();
+    printSCCs(*slot, engine, format);
+    cachedVersion[(int)format] = version;
+    return slot;
+}
+
+const Condensation &Graph::condensation(SCCEngine engine)
+{
+    if (dagVersion == version)
+        return dag;
+    const SCCResult &r = sccs(engine);
+    int count = (int)r.size.size();
+
+    // Counting sort the vertices by component, so each row is built from one member list
+    dag.memberStart.assign(count + 1, 0);
+    for (int c = 0; c < count; c++)
+        dag.memberStart[c + 1] = dag.memberStart[c] + r.size[c];
+    dag.members.resize(V);
+    vector<int> pos(dag.memberStart.begin(), dag.memberStart.end() - 1);
+    for (int v = 0; v < V; v++)
+        dag.members[pos[r.comp[v]]++] = v;
+
+    // seen[d] == c once row c has its edge to d, so every DAG edge is kept once
+    vector<int> seen(count, -1);
+    vector<int> indegree(count, 0);
+    dag.offsets.assign(count + 1, 0);
+    dag.targets.clear();
+    for (int c = 0; c < count; c++)
+    {
+        for (int i = dag.memberStart[c]; i < dag.memberStart[c + 1]; i++)
+            for (int w : adj[dag.members[i]])
+            {
+                int d = r.comp[w];
+                if (d != c && seen[d] != c)
+                {
+                    seen[d] = c;
+                    dag.targets.push_back(d);
+                    indegree[d]++;
+                }
+            }
+        dag.offsets[c + 1] = (int)dag.targets.size();
+    }
+
+    // Ids already count down along a topological order
+    dag.order.resize(count);
+    dag.sources.clear();
+    dag.sinks.clear();
+    for (int i = 0; i < count; i++)
+    {
+        int c = count - 1 - i;
+        dag.order[i] = c;
+        if (indegree[c] == 0)
+            dag.sources.push_back(c);
+        if (dag.offsets[c + 1] == dag.offsets[c])
+            dag.sinks.push_back(c);
+    }
+
+    dagVersion = version;
+    return dag;
+}
+
+void Graph::printCondensation(OutputBuffer &out, DAGQuery query, SCCEngine engine)
+{
+    const Condensation &d = condensation(engine);
+    if (query == DAGQuery::Summary)
+    {
+        out.append("Components: ");
+        out.putInt((int)d.order.size());
+        out.append("\nDAG edges: ");
+        out.putInt((int)d.targets.size());
+        out.append("\nSources: ");
+        out.putInt((int)d.sources.size());
+        out.append("\nSinks: ");
+        out.putInt((int)d.sinks.size());
+        out.put('\n');
+        return;
+    }
+
+    for (int c : query == DAGQuery::Sources ? d.sources : d.sinks)
+        putComponent(out, &d.members[d.memberStart[c]], d.memberStart[c + 1] - d.memberStart[c]);
+}
+
+ReachIndex &Graph::reachIndex(SCCEngine engine)
+{
+    if (reachVersion == version)
+        return reach;
+    const Condensation &d = condensation(engine);
+    int count = (int)d.order.size();
+
+    // Traversals alternate between visiting roots and children forward and
+    // backward, and later ones start from the middle of the order, so the
+    // labelings disagree wherever the DAG branches
+    vector<pair<int, int>> frames; // (component, next DAG edge)
+    vector<char> visited;
+    for (int t = 0; t < ReachIndex::LABELS; t++)
+    {
+        vector<int> &low = reach.low[t], &first = reach.first[t], &post = reach.post[t];
+        bool forward = t % 2 == 0;
+        int shift = (int)((long long)count * (t / 2) / ReachIndex::LABELS);
+        low.assign(count, 0);
+        first.assign(count, 0);
+        post.assign(count, 0);
+        visited.assign(count, 0);
+        int rank = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            int slot = (i + shift) % count;
+            int root = d.order[forward ? slot : count - 1 - slot];
+            if (visited[root])
+                continue;
+            visited[root] = 1;
+            first[root] = rank;
+            frames.push_back({root, 0});
+            while (!frames.empty())
+            {
+                int c = frames.back().first;
+                int degree = d.offsets[c + 1] - d.offsets[c];
+                if (frames.back().second < degree)
+                {
+                    int k = frames.back().second++;
+                    int next = d.targets[forward ? d.offsets[c] + k : d.offsets[c + 1] - 1 - k];
+                    if (!visited[next])
+                    {
+                        visited[next] = 1;
+                        first[next] = rank;
+                        frames.push_back({next, 0});
+                    }
+                    continue;
+                }
+
+                // Children are done; the lowest rank below c includes ones reached earlier
+                post[c] = rank++;
+                low[c] = post[c];
+                for (int e = d.offsets[c]; e < d.offsets[c + 1]; e++)
+                    low[c] = min(low[c], low[d.targets[e]]);
+                frames.pop_back();
+            }
+        }
+    }
+
+    reach.seen.assign(count, 0);
+    reach.stamp = 0;
+    reachVersion = version;
+    return reach;
+}
+
+bool Graph::canReach(int u, int v, SCCEngine engine)
+{
+    ReachIndex &index = reachIndex(engine);
+    const Condensation &d = dag;
+    const vector<int> &comp = result.comp;
+    int from = comp[u], to = comp[v];
+
+    // DAG edges only lead to lower ids, so most negatives end here
+    if (from == to)
+        return true;
+    if (from < to || !index.mayReach(from, to))
+        return false;
+    if (index.surelyReaches(from, to))
+        return true;
+
+    // Labels can't rule it out: search, entering only components whose labels still allow a path
+    if (++index.stamp == 0)
+    {
+        fill(index.seen.begin(), index.seen.end(), 0);
+        index.stamp = 1;
+    }
+    index.stack.assign(1, from);
+    index.seen[from] = index.stamp;
+    while (!index.stack.empty())
+    {
+        int c = index.stack.back();
+        index.stack.pop_back();
+        for (int e = d.offsets[c]; e < d.offsets[c + 1]; e++)
+        {
+            int next = d.targets[e];
+            if (next == to || index.surelyReaches(next, to))
+                return true;
+            if (next > to && index.seen[next] != index.stamp && index.mayReach(next, to))
+            {
+                index.seen[next] = index.stamp;
+                index.stack.push_back(next);
+            }
+        }
+    }
+    return false;
+}
+
+// Print components given as an id per vertex (-1 = unassigned), one line each. Ids count in
+// reverse topological order, so they are printed from the highest down to
+// keep Kosaraju's source-first order.
+void Graph::printComponents(const vector<int> &comp, int count, OutputBuffer &out)
+{
+    // Counting sort the assigned vertices by component id
+    vector<int> start(count + 1, 0);
+    for (int v = 0; v < V; v++)
+        if (comp[v] >= 0)
+            start[comp[v] + 1]++;
+    for (int c = 0; c < count; c++)
+        start[c + 1] += start[c];
+
+    vector<int> members(start[count]);
+    vector<int> pos(start.begin(), start.end() - 1);
+    for (int v = 0; v < V; v++)
+        if (comp[v] >= 0)
+            members[pos[comp[v]]++] = v;
+
+    for (int c = count - 1; c >= 0; c--)
+        putComponent(out, &members[start[c]], start[c + 1] - start[c]);
+}
+
+bool Graph::isLargeSCC(SCCEngine engine)
+{
+    const SCCResult &r = sccs(engine);
+    return r.largest >= 0 && r.size[r.largest] >= V / 2;
+}
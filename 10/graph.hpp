@@ -0,0 +1,183 @@
+#ifndef GRAPH_HPP
+#define GRAPH_HPP
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include "scc_output.hpp"
+
+using namespace std;
+
+// Algorithms the server can use to compute SCCs
+enum class SCCEngine
+{
+    Kosaraju, // Two DFS passes, the second over the transpose
+    Pearce,   // Pearce's single-pass variant of Tarjan, no transpose
+    Parallel  // Forward-backward + coloring on the shared worker pool
+};
+
+// Parse an engine name from a Kosaraju command; an empty name selects Kosaraju
+bool parseEngine(const string &name, SCCEngine &engine);
+
+// Outcome of one SCC computation, shared by the listing and the majority check
+struct SCCResult
+{
+    vector<int> comp;  // Component id of every vertex, dense; the highest id is a source
+    vector<int> size;  // Member count of every component
+    int largest = -1;  // Id of the biggest component, -1 for an empty graph
+};
+
+// Component DAG of an SCCResult in CSR form: one node per component id and an
+// edge c -> d, kept once, whenever some edge leads from component c into d.
+// Every DAG edge goes from a higher id to a lower one.
+struct Condensation
+{
+    vector<int> offsets;     // Row starts into targets, one per id plus the end
+    vector<int> targets;     // Successor ids, grouped by row
+    vector<int> order;       // Component ids in topological order, sources first
+    vector<int> sources;     // Ids without a predecessor, in topological order
+    vector<int> sinks;       // Ids without a successor, in topological order
+    vector<int> memberStart; // members[memberStart[c]] .. members[memberStart[c + 1] - 1] form component c
+    vector<int> members;
+};
+
+// GRAIL reachability labels over a Condensation. Every traversal of the DAG
+// gives a component the interval [low, post]: its post-order rank and the
+// smallest rank below it. If c reaches d, d's interval nests in c's for every
+// traversal, so one label that doesn't nest proves d unreachable. The ranks
+// [first, post] of c's own DFS subtree prove the opposite when d falls inside.
+struct ReachIndex
+{
+    static const int LABELS = 3;
+    vector<int> low[LABELS];
+    vector<int> first[LABELS];
+    vector<int> post[LABELS];
+    vector<int> seen; // Scratch for the fallback DFS: seen[c] == stamp once visited
+    int stamp = 0;
+    vector<int> stack;
+
+    bool mayReach(int c, int d) const
+    {
+        for (int t = 0; t < LABELS; t++)
+            if (low[t][d] < low[t][c] || post[t][d] > post[t][c])
+                return false;
+        return true;
+    }
+
+    bool surelyReaches(int c, int d) const
+    {
+        for (int t = 0; t < LABELS; t++)
+            if (first[t][c] <= post[t][d] && post[t][d] <= post[t][c])
+                return true;
+        return false;
+    }
+};
+
+// What printCondensation reports
+enum class DAGQuery
+{
+    Summary, // Component, DAG edge, source and sink counts
+    Sources, // Source components, one line of vertices each
+    Sinks    // Sink components, one line of vertices each
+};
+
+// One operation of a Batch command, with 0-based vertices
+struct EdgeOp
+{
+    bool add; // Add v -> w, or remove every copy of it
+    int v, w;
+};
+
+// Graph class to represent a directed graph using adjacency list representation
+class Graph
+{
+    int V;                    // Number of vertices
+    vector<vector<int>> adj;  // Adjacency list
+    vector<vector<int>> radj; // Reverse adjacency list, kept in step with adj
+    vector<vector<int>> adjPos;  // adjPos[v][i]: index of the edge v -> adj[v][i] in radj[adj[v][i]]
+    vector<vector<int>> radjPos; // radjPos[w][j]: index of the edge radj[w][j] -> w in adj[radj[w][j]]
+
+    // Hash index over the out-edges of vertices with more than HUB_DEGREE of them:
+    // target -> slots in adj. Smaller lists are cheaper to scan.
+    static const size_t HUB_DEGREE = 32;
+    unordered_map<int, unordered_multimap<int, int>> hubIndex;
+    bool dedup; // Keep a single copy of every edge: addEdge ignores one already present
+
+    // Live SCCs: computed by the first query, then kept up to date by addEdge
+    // and removeEdge. Every component owns the order slot [sccOrd, sccOrd + sccSpan),
+    // so a split can hand out sub-slots without moving any other component.
+    bool live = false;
+    vector<int> sccOf;              // Component id of every vertex
+    vector<vector<int>> sccMembers; // Members of every id; empty once merged away
+    vector<long long> sccOrd;       // Slot start of every id in a topological order, sources first
+    vector<long long> sccSpan;      // Slot width of every id
+    vector<char> sccMark;           // Scratch marks for insertEdgeLive, all 0 between calls
+    vector<int> sccLocal;           // Scratch: index of a vertex within its component's member list
+    long long liveBudget = 0;       // Edge scans left before a rebuild would have been cheaper
+
+    // Batches longer than this drop the live SCCs instead of repairing them edge by edge
+    static const size_t LIVE_BATCH = 64;
+
+    // Serialized results per output format, each tagged with the version it was made for
+    unsigned long version = 0; // Bumped by every mutation
+    unsigned long cachedVersion[3] = {};
+    shared_ptr<OutputBuffer> cached[3];
+    SCCResult result;
+    unsigned long resultVersion = ~0UL; // Version result was computed for
+    Condensation dag;
+    unsigned long dagVersion = ~0UL; // Version dag was built for
+    ReachIndex reach;
+    unsigned long reachVersion = ~0UL; // Version reach was labeled for
+
+    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames);
+    void DFSUtil(const vector<vector<int>> &lists, int v, vector<bool> &visited, vector<int> &members, vector<pair<int, int>> &frames);
+    void unlinkEdge(int v, int i);
+    void indexHub(int v);
+    bool hasEdge(int v, int w);
+    bool insertEdge(int v, int w);
+    bool eraseEdge(int v, int w);
+
+    int trim(vector<int> &comp);
+    int kosarajuSCC(vector<int> &comp);
+    int pearceSCC(vector<int> &comp);
+    int computeSCCs(SCCEngine engine, vector<int> &comp);
+    void buildLive(SCCEngine engine);
+    bool reachLive(int from, const vector<vector<int>> &lists, long long lower, long long upper, char bit, vector<int> &found);
+    void insertEdgeLive(int v, int w);
+    void dropLive(const vector<int> &marked);
+    void renumberLive();
+    void splitLive(int c);
+    void toCSR(vector<int> &offsets, vector<int> &targets, bool transpose);
+    void printComponents(const vector<int> &comp, int count, OutputBuffer &out);
+    const SCCResult &sccs(SCCEngine engine);
+    ReachIndex &reachIndex(SCCEngine engine);
+
+public:
+    Graph(int V, bool dedup = false);
+    void addEdge(int v, int w);
+    void removeEdge(int v, int w);
+    // Apply every operation in order as one mutation: a single version step, one log line
+    void applyBatch(const vector<EdgeOp> &ops);
+    // Quietly add the edges of ops to a graph that nobody else sees yet
+    void loadEdges(const vector<EdgeOp> &ops);
+    // engine only matters when the live SCCs have to be (re)computed
+    void printSCCs(OutputBuffer &out, SCCEngine engine = SCCEngine::Kosaraju, OutputFormat format = OutputFormat::Text);
+    // printSCCs through the cache: an unchanged graph gets the previous bytes back.
+    // The buffer stays valid for the holder after later mutations.
+    shared_ptr<const OutputBuffer> sccResult(SCCEngine engine = SCCEngine::Kosaraju, OutputFormat format = OutputFormat::Text);
+    unsigned long getVersion() const { return version; }
+    int vertices() const { return V; }
+    Graph getTranspose();
+    // The component DAG of the current SCCs, built once per version
+    const Condensation &condensation(SCCEngine engine = SCCEngine::Kosaraju);
+    void printCondensation(OutputBuffer &out, DAGQuery query, SCCEngine engine = SCCEngine::Kosaraju);
+    // Whether a path leads from u to v, answered from the reachability labels
+    bool canReach(int u, int v, SCCEngine engine = SCCEngine::Kosaraju);
+    // True if one SCC holds at least half of the vertices
+    bool isLargeSCC(SCCEngine engine = SCCEngine::Kosaraju);
+};
+
+#endif // GRAPH_HPP
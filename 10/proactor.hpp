@@ -2,7 +2,12 @@
 #define PROACTOR_HPP
 
 #include <pthread.h>
-#include <map>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <functional>
 
 using namespace std;
@@ -11,19 +16,61 @@ using namespace std;
 // Define a function type for the proactor
 typedef function<void(int)> proactorFunc;
 
+// Pool of worker threads that serve accepted sockets as tasks. Every core
+// worker has its own queue; a worker whose queue is empty steals from the
+// others. A task is a whole client session, so whenever no worker is idle an
+// extra worker is started for the new socket; extras steal like the others and
+// exit once they have been idle for EXTRA_IDLE_SECONDS. At most
+// MAX_EXTRA_WORKERS extras run at once: past that, a socket waits in the
+// queues until a session ends, and past maxQueued waiting sockets it is
+// refused. Threads and memory stay bounded however many clients connect.
 class Proactor {
 public:
-    Proactor();
+    // workers == 0 picks DEFAULT_WORKERS_PER_CORE per core, kept even when idle;
+    // at most maxQueued sockets wait for a worker to pick them up
+    Proactor(int workers = 0, int maxQueued = 1024);
     ~Proactor();
 
-    // Starts a new proactor and returns the proactor thread
-    pthread_t startProactor(int sockfd, proactorFunc threadFunc);
+    // Queues sockfd for the next free worker; throws runtime_error when the queue is full
+    void startProactor(int sockfd, proactorFunc threadFunc);
 
-    // Stops the proactor by thread id
-    int stopProactor(pthread_t tid);
+    // Lets every worker, extras included, finish its current task, then closes the sockets still queued
+    int stopProactor();
+
+    static const int DEFAULT_WORKERS_PER_CORE = 4;
+    static const int EXTRA_IDLE_SECONDS = 10;
+    static const int MAX_EXTRA_WORKERS = 64;
 
 private:
-    map<pthread_t, proactorFunc> proactorMap;
+    struct Task
+    {
+        int sockfd;
+        proactorFunc func;
+    };
+
+    struct Worker
+    {
+        pthread_t tid;
+        mutex m;           // Guards tasks; taken by the owner and by thieves
+        deque<Task> tasks; // Served oldest first, by the owner and thieves alike
+    };
+
+    static void *workerStart(void *arg);
+    void workerLoop(int id);
+    bool takeTask(int id, Task &task);
+    void startExtra(int id);
+
+    vector<unique_ptr<Worker>> workers;
+    int maxQueued;
+    atomic<int> queued{0};        // Tasks in all queues together
+    atomic<unsigned> nextWorker{0}; // Round-robin target of startProactor
+    mutex idleMutex;              // Idle workers sleep on wake under it; guards the fields below
+    condition_variable wake;
+    int idle = 0;                 // Workers waiting on wake
+    int extras = 0;               // Extra workers still running
+    int nextExtra = 0;            // Id of the next extra, after the core workers' ids
+    condition_variable extrasDone; // Signalled when the last extra exits
+    bool stopping = false;
 };
 
 #endif // PROACTOR_HPP
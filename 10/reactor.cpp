@@ -0,0 +1,112 @@
+#include "reactor.hpp"
+#include <iostream>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+
+Reactor::Reactor(bool edgeTriggered) : edgeTriggered(edgeTriggered), events(64), running(true)
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0)
+        perror("epoll_create1");
+}
+
+Reactor::~Reactor()
+{
+    stopReactor();
+    if (epollFd >= 0)
+        close(epollFd);
+}
+
+void *Reactor::startReactor()
+{
+    return this;
+}
+
+int Reactor::addFdToReactor(int fd, reactorFunc func)
+{
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | (edgeTriggered ? EPOLLET : 0);
+    ev.data.fd = fd;
+
+    // Registering an fd again just replaces its callback
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0 &&
+        (errno != EEXIST || epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) < 0))
+    {
+        perror("epoll_ctl");
+        return -1;
+    }
+
+    if (fd >= (int)callbacks.size())
+        callbacks.resize(fd + 1);
+    callbacks[fd] = func;
+    return 0;
+}
+
+int Reactor::removeFdFromReactor(int fd)
+{
+    // A closed fd has already left the epoll set on its own
+    if (epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr) < 0 && errno != EBADF && errno != ENOENT)
+        perror("epoll_ctl");
+    if (fd < (int)callbacks.size())
+        callbacks[fd] = nullptr;
+    return 0;
+}
+
+int Reactor::waitForWritable(int fd, bool writable)
+{
+    struct epoll_event ev = {};
+    ev.events = (writable ? EPOLLOUT : EPOLLIN) | (edgeTriggered ? EPOLLET : 0);
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) < 0)
+    {
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+int Reactor::stopReactor()
+{
+    cout << "Reactor stopped" << endl;
+    running = false;
+    return 0;
+}
+
+/**
+ * Runs the reactor, waiting for ready fds and executing the corresponding
+ * callback functions.
+ */
+void Reactor::run()
+{
+    running = true;
+
+    while (running)
+    {
+        int ready = epoll_wait(epollFd, events.data(), (int)events.size(), 1000);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        // Hangups and errors go to the callback too, so it can see the failed read and clean up
+        for (int i = 0; i < ready; i++)
+        {
+            int fd = events[i].data.fd;
+
+            // An earlier callback in this batch may have removed fd
+            if (fd < (int)callbacks.size() && callbacks[fd])
+            {
+                // Call a copy: the callback may register fds and grow the table under itself
+                reactorFunc func = callbacks[fd];
+                func(fd);
+            }
+        }
+
+        if (ready == (int)events.size())
+            events.resize(events.size() * 2);
+    }
+}
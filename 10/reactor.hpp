@@ -0,0 +1,40 @@
+#ifndef REACTOR_HPP
+#define REACTOR_HPP
+
+#include <vector>
+#include <functional>
+#include <sys/epoll.h>
+
+using namespace std;
+
+using reactorFunc = function<void(int)>;
+
+// Event loop over epoll: registering and removing an fd are single epoll_ctl
+// calls, and each wakeup only visits the fds that are ready.
+class Reactor
+{
+private:
+    int epollFd;                       // epoll instance holding every registered fd
+    bool edgeTriggered;                // Register with EPOLLET; callbacks must then drain their fd
+    vector<reactorFunc> callbacks;     // Indexed by fd; empty for fds not registered
+    vector<struct epoll_event> events; // Filled by epoll_wait, grown when a wakeup fills it
+
+    bool running = true;
+
+public:
+    Reactor(bool edgeTriggered = false);
+    ~Reactor();
+    Reactor(const Reactor &) = delete;
+    Reactor &operator=(const Reactor &) = delete;
+
+    void *startReactor();
+    int addFdToReactor(int fd, reactorFunc func);
+    int removeFdFromReactor(int fd);
+    // Call fd's callback when it can be written instead of read, or back again
+    int waitForWritable(int fd, bool writable);
+    int stopReactor();
+
+    void run();
+};
+
+#endif // REACTOR_HPP
@@ -0,0 +1,187 @@
+#include "scc_output.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <climits>
+#include <sys/uio.h>
+
+bool parseFormat(const string &name, OutputFormat &format)
+{
+    if (name.empty() || name == "text")
+        format = OutputFormat::Text;
+    else if (name == "ids")
+        format = OutputFormat::Ids;
+    else if (name == "deltas")
+        format = OutputFormat::Deltas;
+    else
+        return false;
+    return true;
+}
+
+void OutputBuffer::clear()
+{
+    current = 0;
+    if (chunks.empty())
+    {
+        cursor = limit = nullptr;
+        return;
+    }
+    cursor = chunks[0].data.get();
+    limit = cursor + CHUNK;
+}
+
+size_t OutputBuffer::size() const
+{
+    if (!cursor)
+        return 0;
+    size_t total = 0;
+    for (size_t i = 0; i <= current; i++)
+        total += used(i);
+    return total;
+}
+
+void OutputBuffer::nextChunk()
+{
+    if (cursor)
+    {
+        chunks[current].used = cursor - chunks[current].data.get();
+        current++;
+    }
+    if (current == chunks.size())
+        chunks.push_back({unique_ptr<char[]>(new char[CHUNK]), 0});
+
+    cursor = chunks[current].data.get();
+    limit = cursor + CHUNK;
+}
+
+void OutputBuffer::append(const void *data, size_t n)
+{
+    const char *p = (const char *)data;
+    while (n > 0)
+    {
+        room(1);
+        size_t part = min(n, (size_t)(limit - cursor));
+        memcpy(cursor, p, part);
+        cursor += part;
+        p += part;
+        n -= part;
+    }
+}
+
+void OutputBuffer::gather(vector<iovec> &iov) const
+{
+    if (!cursor)
+        return;
+    for (size_t i = 0; i <= current; i++)
+        if (used(i) > 0)
+            iov.push_back({chunks[i].data.get(), used(i)});
+}
+
+bool OutputBuffer::writeTo(int fd) const
+{
+    vector<iovec> iov;
+    gather(iov);
+    return writeAll(fd, iov);
+}
+
+// Drop the n bytes at the front of iov[first..], possibly part of a chunk
+static void dropSent(vector<iovec> &iov, size_t &first, size_t n)
+{
+    while (first < iov.size() && n >= iov[first].iov_len)
+        n -= iov[first++].iov_len;
+    if (first < iov.size())
+    {
+        iov[first].iov_base = (char *)iov[first].iov_base + n;
+        iov[first].iov_len -= n;
+    }
+}
+
+bool writeAll(int fd, vector<iovec> &iov)
+{
+    // Normally one call; more only for huge results (IOV_MAX) or short writes
+    size_t first = 0;
+    while (first < iov.size())
+    {
+        ssize_t n = writev(fd, &iov[first], (int)min(iov.size() - first, (size_t)IOV_MAX));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("writev");
+            return false;
+        }
+        dropSent(iov, first, n);
+    }
+    return true;
+}
+
+bool writeSome(int fd, vector<iovec> &iov, size_t &sent)
+{
+    size_t first = 0;
+    while (first < iov.size())
+    {
+        ssize_t n = writev(fd, &iov[first], (int)min(iov.size() - first, (size_t)IOV_MAX));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break; // The socket buffer is full; the rest waits for room
+            perror("writev");
+            return false;
+        }
+        sent += n;
+        dropSent(iov, first, n);
+    }
+    return true;
+}
+
+string OutputBuffer::str() const
+{
+    string result;
+    result.reserve(size());
+    if (cursor)
+        for (size_t i = 0; i <= current; i++)
+            result.append(chunks[i].data.get(), used(i));
+    return result;
+}
+
+void writeComponents(OutputBuffer &out, OutputFormat format, const vector<int> &comp, int count)
+{
+    uint32_t header[2] = {(uint32_t)comp.size(), (uint32_t)count};
+    int V = (int)comp.size();
+
+    if (format == OutputFormat::Ids)
+    {
+        out.append("SCCI", 4);
+        out.append(header, sizeof(header));
+        out.append(comp.data(), V * sizeof(int));
+        return;
+    }
+
+    // Deltas: counting sort by id keeps every member list ascending
+    vector<int> start(count + 1, 0);
+    for (int v = 0; v < V; v++)
+        start[comp[v] + 1]++;
+    for (int c = 0; c < count; c++)
+        start[c + 1] += start[c];
+
+    vector<int> members(V);
+    vector<int> pos(start.begin(), start.end() - 1);
+    for (int v = 0; v < V; v++)
+        members[pos[comp[v]]++] = v;
+
+    out.append("SCCD", 4);
+    out.append(header, sizeof(header));
+    for (int c = 0; c < count; c++)
+    {
+        out.putVarint(start[c + 1] - start[c]);
+        int previous = 0;
+        for (int i = start[c]; i < start[c + 1]; i++)
+        {
+            out.putVarint(members[i] - previous);
+            previous = members[i];
+        }
+    }
+}
@@ -8,151 +8,24 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <queue>
+#include <memory>
+#include <unordered_map>
+#include <csignal>
+#include <cerrno>
 #include "proactor.hpp"
+#include "reactor.hpp"
+#include "uring_proactor.hpp"
+#include "session.hpp"
+#include "graph.hpp"
 
 using namespace std;
 
-// Graph class to represent a directed graph using adjacency list representation
-class Graph
-{
-    int V;                   // Number of vertices
-    vector<vector<int>> adj; // Adjacency list
-
-    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque);
-    void DFSUtil(int v, vector<bool> &visited, stringstream &out);
-
-public:
-    Graph(int V);
-    void addEdge(int v, int w);
-    void removeEdge(int v, int w);
-    string printSCCs();
-    Graph getTranspose();
-    bool isLargeSCC();
-};
-
-Graph::Graph(int V)
-{
-    this->V = V;
-    adj.resize(V);
-}
-
-void Graph::addEdge(int v, int w)
-{
-    adj[v].push_back(w);
-    cout << "Edge added from " << v + 1 << " to " << w + 1 << endl;
-}
-
-void Graph::removeEdge(int v, int w)
-{
-    adj[v].erase(remove(adj[v].begin(), adj[v].end(), w), adj[v].end());
-    cout << "Edge removed from " << v + 1 << " to " << w + 1 << endl;
-}
-
-void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque)
-{
-    visited[v] = true;
-    for (int i : adj[v])
-        if (!visited[i])
-            fillOrder(i, visited, Deque);
-    Deque.push_back(v);
-}
-
-Graph Graph::getTranspose()
-{
-    Graph g(V);
-    for (int v = 0; v < V; v++)
-    {
-        for (int i : adj[v])
-            g.adj[i].push_back(v);
-    }
-    return g;
-}
-
-void Graph::DFSUtil(int v, vector<bool> &visited, stringstream &out)
-{
-    visited[v] = true;
-    out << v + 1 << " ";
-    for (int i : adj[v])
-        if (!visited[i])
-            DFSUtil(i, visited, out);
-}
-
-string Graph::printSCCs()
-{
-    deque<int> Deque;
-    vector<bool> visited(V, false);
-    stringstream result;
-
-    for (int i = 0; i < V; i++)
-        if (!visited[i])
-            fillOrder(i, visited, Deque);
-
-    Graph gr = getTranspose();
-
-    fill(visited.begin(), visited.end(), false);
-
-    while (!Deque.empty())
-    {
-        int v = Deque.back();
-        Deque.pop_back();
-        if (!visited[v])
-        {
-            gr.DFSUtil(v, visited, result);
-            result << endl;
-        }
-    }
-
-    return result.str();
-}
-
-bool Graph::isLargeSCC()
-{
-    deque<int> Deque;
-    vector<bool> visited(V, false);
-
-    // Fill vertices in stack according to their finishing times
-    for (int i = 0; i < V; i++)
-        if (!visited[i])
-            fillOrder(i, visited, Deque);
-
-    // Create a reversed graph
-    Graph gr = getTranspose();
-
-    // Mark all the vertices as not visited (For second DFS)
-    fill(visited.begin(), visited.end(), false);
-
-    // Process all vertices in order defined by Deque
-    while (!Deque.empty())
-    {
-        int v = Deque.back();
-        Deque.pop_back();
-        if (!visited[v])
-        {
-            stringstream scc;
-            gr.DFSUtil(v, visited, scc);
-
-            // Convert stringstream to a vector of nodes
-            vector<int> sccNodes;
-            int node;
-            while (scc >> node)
-            {
-                sccNodes.push_back(node);
-            }
-            // Check if SCC contains at least 50% of nodes
-            size_t check = V / 2;
-            if (sccNodes.size() >= check)
-            {
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
-
 // Global pointer to the graph object
 Graph *g = nullptr;
 
+// Set by -d: every graph keeps a single copy of each edge
+bool dedupEdges = false;
+
 pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t cv = PTHREAD_COND_INITIALIZER;
 queue<bool> notificationQueue;
@@ -190,121 +63,151 @@ void *consumer(void *arg)
     return nullptr;
 }
 
-// Function to handle client requests
+// One pooled worker reads the client's socket until it leaves
 void handleClient(int clientSocket)
 {
-    char buffer[1024];
-    string line;
+    Session session;
+    ReplyQueue out;
+    session.start(out);
+    vector<char> buffer(1 << 16);
+
+    while (out.writeTo(clientSocket))
+    {
+        ssize_t bytesReceived = recv(clientSocket, buffer.data(), buffer.size(), 0);
+        if (bytesReceived < 1)
+            break;
+        session.feed(buffer.data(), bytesReceived, out);
+    }
 
-    string instructions = "Please insert one of the following commands:\n"
-                          "Newgraph <n> <m> - Create a new graph with n vertices and m edges\n"
-                          "Kosaraju - Print SCCs of the graph\n"
-                          "Newedge <i> <j> - Add edge from vertex i to vertex j\n"
-                          "Removeedge <i> <j> - Remove edge from vertex i to vertex j\n";
-    send(clientSocket, instructions.c_str(), instructions.size(), 0);
+    cout << "Client disconnected." << endl;
+    close(clientSocket);
+}
+
+// Thread backend: accepted sockets wait for a worker of the bounded pool
+void serveThreads(int serverSocket)
+{
+    Proactor proactor;
 
     while (true)
     {
-        ssize_t bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-        if (bytesReceived < 1)
+        int clientSocket;
+        sockaddr_in clientAddr;
+        socklen_t clientAddrSize = sizeof(clientAddr);
+
+        clientSocket = accept(serverSocket, (struct sockaddr *)&clientAddr, &clientAddrSize);
+        if (clientSocket < 0)
         {
-            cout << "Client disconnected." << endl;
-            close(clientSocket);
-            return;
+            perror("accept");
+            continue;
         }
-        buffer[bytesReceived] = '\0';
-        line = buffer;
-
-        istringstream iss(line);
-        string command;
-        iss >> command;
 
-        if (command == "Newgraph")
+        try
         {
-            int n, m;
-            iss >> n >> m;
-            pthread_mutex_lock(&mtx);
-            delete g;
-            g = new Graph(n);
-            pthread_mutex_unlock(&mtx);
-            cout << "New graph created with " << n << " vertices." << endl;
-            for (int i = 0; i < m; ++i)
-            {
-                int src, dest;
-                recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-                istringstream edgeStream(buffer);
-                edgeStream >> src >> dest;
-                g->addEdge(src - 1, dest - 1);
-            }
-            send(clientSocket, "Created new graph\n", 18, 0);
+            proactor.startProactor(clientSocket, handleClient);
         }
-        else if (command == "Kosaraju")
+        catch (const std::exception &e)
         {
-            pthread_mutex_lock(&mtx);
-            if (g)
-            {
-                string result = g->printSCCs();
+            cerr << "Failed to queue client: " << e.what() << endl;
+            close(clientSocket);
+        }
+    }
+}
 
-                // Check and notify about large SCC
-                bool conditionMet = g->isLargeSCC();
-                notificationQueue.push(conditionMet);
-                pthread_cond_signal(&cv);
+// Epoll backend, used when io_uring is unavailable: one thread, one Session per
+// client, a read per readiness event. Sockets are non-blocking; a client whose
+// replies don't fit in its socket buffer is watched for room instead of input
+// until they have gone out, so it can neither stall the others nor make the
+// server queue more replies for it.
+void serveEpoll(int serverSocket)
+{
+    struct Client
+    {
+        Session session;
+        ReplyQueue out;
+        bool writing = false; // Waiting for room to send out
+    };
+    unordered_map<int, unique_ptr<Client>> clients;
+    vector<char> buffer(1 << 16);
+    Reactor reactor;
+
+    // Send what the socket takes and wait for whichever of input or room comes next
+    auto flush = [&](int fd, Client &client)
+    {
+        if (!client.out.writeSome(fd))
+            return false;
+        if (client.writing == !client.out.empty())
+            return true;
+        client.writing = !client.writing;
+        return reactor.waitForWritable(fd, client.writing) == 0;
+    };
+
+    auto disconnect = [&](int fd)
+    {
+        reactor.removeFdFromReactor(fd);
+        clients.erase(fd);
+        close(fd);
+    };
 
-                pthread_mutex_unlock(&mtx);
-                cout << "Kosaraju's algorithm executed." << endl;
-                send(clientSocket, result.c_str(), result.size(), 0);
-            }
-            else
-            {
-                pthread_mutex_unlock(&mtx);
-                send(clientSocket, "No graph created yet.\n", 22, 0);
-            }
-        }
-        else if (command == "Newedge")
+    reactorFunc serveClient = [&](int readySocket)
+    {
+        Client &client = *clients[readySocket];
+        bool open = true;
+        if (!client.writing)
         {
-            int i, j;
-            iss >> i >> j;
-            pthread_mutex_lock(&mtx);
-            if (g)
-            {
-                g->addEdge(i - 1, j - 1);
-                pthread_mutex_unlock(&mtx);
-                send(clientSocket, "Edge added\n", 11, 0);
-            }
-            else
-            {
-                pthread_mutex_unlock(&mtx);
-                send(clientSocket, "No graph created yet.\n", 22, 0);
-            }
+            ssize_t bytesReceived = recv(readySocket, buffer.data(), buffer.size(), 0);
+            if (bytesReceived > 0)
+                client.session.feed(buffer.data(), bytesReceived, client.out);
+            else if (bytesReceived == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                open = false;
         }
-        else if (command == "Removeedge")
+        if (open && flush(readySocket, client))
+            return;
+
+        cout << "Client disconnected." << endl;
+        disconnect(readySocket);
+    };
+
+    reactor.addFdToReactor(serverSocket, [&](int fd)
+                           {
+        int clientSocket = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK);
+        if (clientSocket < 0)
         {
-            int i, j;
-            iss >> i >> j;
-            pthread_mutex_lock(&mtx);
-            if (g)
-            {
-                g->removeEdge(i - 1, j - 1);
-                pthread_mutex_unlock(&mtx);
-                send(clientSocket, "Edge removed\n", 13, 0);
-            }
-            else
-            {
-                pthread_mutex_unlock(&mtx);
-                send(clientSocket, "No graph created yet.\n", 22, 0);
-            }
+            perror("accept4");
+            return;
         }
+
+        Client *client = new Client();
+        clients[clientSocket].reset(client);
+        client->session.start(client->out);
+        if (reactor.addFdToReactor(clientSocket, serveClient) < 0 || !flush(clientSocket, *client))
+            disconnect(clientSocket); });
+
+    reactor.run();
+}
+
+int main(int argc, char *argv[])
+{
+    string backend = "uring";
+    for (int arg = 1; arg < argc; arg++)
+    {
+        string flag = argv[arg];
+        if (flag == "-d")
+            dedupEdges = true;
+        else if (flag == "-b" && arg + 1 < argc && (string(argv[arg + 1]) == "uring" || string(argv[arg + 1]) == "epoll" || string(argv[arg + 1]) == "threads"))
+            backend = argv[++arg];
         else
         {
-            send(clientSocket, "Invalid command\n", 16, 0);
+            cerr << "Usage: " << argv[0] << " [-d] [-b uring|epoll|threads]" << endl;
+            cerr << "  -d  drop parallel edges as they arrive instead of storing every copy" << endl;
+            cerr << "  -b  io_uring completions (default; epoll when io_uring is unavailable)," << endl;
+            cerr << "      an epoll event loop, or a pool of threads serving one client each" << endl;
+            return 1;
         }
     }
 
-    close(clientSocket);
-}
+    // A client that leaves mid-reply must not take the server with it
+    signal(SIGPIPE, SIG_IGN);
 
-int main()
-{
     int serverSocket;
     sockaddr_in serverAddr;
 
@@ -342,7 +245,7 @@ int main()
     cout << "bind successful" << endl;
 
     // Listen for incoming connections
-    if (listen(serverSocket, 5) < 0)
+    if (listen(serverSocket, SOMAXCONN) < 0)
     {
         perror("listen");
         close(serverSocket);
@@ -351,34 +254,33 @@ int main()
 
     cout << "Server is running on port 9034..." << endl;
 
-    Proactor proactor;
-
     pthread_t consumerThread;
     pthread_create(&consumerThread, nullptr, consumer, nullptr);
 
-    while (true)
+    if (backend == "uring")
     {
-        int clientSocket;
-        sockaddr_in clientAddr;
-        socklen_t clientAddrSize = sizeof(clientAddr);
-
-        clientSocket = accept(serverSocket, (struct sockaddr *)&clientAddr, &clientAddrSize);
-        if (clientSocket < 0)
-        {
-            perror("accept");
-            continue;
-        }
-
         try
         {
-            proactor.startProactor(clientSocket, handleClient);
+            UringProactor proactor;
+            cout << "Serving clients with io_uring" << endl;
+            proactor.run(serverSocket);
         }
         catch (const std::exception &e)
         {
-            cerr << "Failed to create thread: " << e.what() << endl;
-            close(clientSocket);
+            cerr << e.what() << "; falling back to epoll" << endl;
+            backend = "epoll";
         }
     }
+    if (backend == "epoll")
+    {
+        cout << "Serving clients with epoll" << endl;
+        serveEpoll(serverSocket);
+    }
+    else if (backend == "threads")
+    {
+        cout << "Serving clients with a thread pool" << endl;
+        serveThreads(serverSocket);
+    }
 
     done = true;
     pthread_cond_broadcast(&cv);
@@ -0,0 +1,476 @@
+#include "session.hpp"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <climits>
+#include <cctype>
+#include <cstdlib>
+
+void ReplyQueue::append(const char *data, size_t n)
+{
+    // Consecutive text shares one piece
+    if (pieces.empty() || pieces.back().shared)
+        pieces.push_back({nullptr, text.size(), text.size()});
+    text.append(data, n);
+    pieces.back().end = text.size();
+    bytes += n;
+}
+
+void ReplyQueue::share(shared_ptr<const OutputBuffer> buffer)
+{
+    bytes += buffer->size();
+    pieces.push_back({move(buffer), 0, 0});
+}
+
+void ReplyQueue::clear()
+{
+    text.clear();
+    pieces.clear();
+    bytes = 0;
+}
+
+void ReplyQueue::gather(vector<iovec> &iov) const
+{
+    for (const Piece &piece : pieces)
+    {
+        if (piece.shared)
+        {
+            size_t first = iov.size(), skip = piece.begin;
+            piece.shared->gather(iov);
+            while (skip > 0)
+            {
+                size_t part = min(skip, iov[first].iov_len);
+                iov[first].iov_base = (char *)iov[first].iov_base + part;
+                iov[first].iov_len -= part;
+                skip -= part;
+                if (iov[first].iov_len == 0)
+                    iov.erase(iov.begin() + first);
+            }
+        }
+        else if (piece.end > piece.begin)
+            iov.push_back({(void *)(text.data() + piece.begin), piece.end - piece.begin});
+    }
+}
+
+bool ReplyQueue::writeTo(int fd)
+{
+    vector<iovec> iov;
+    gather(iov);
+    bool ok = writeAll(fd, iov);
+    clear();
+    return ok;
+}
+
+bool ReplyQueue::writeSome(int fd)
+{
+    vector<iovec> iov;
+    gather(iov);
+    size_t sent = 0;
+    bool ok = ::writeSome(fd, iov, sent);
+    consume(sent);
+    return ok;
+}
+
+// Drop the first n bytes, and with them every piece that has gone out whole
+void ReplyQueue::consume(size_t n)
+{
+    bytes -= n;
+    size_t done = 0;
+    for (; done < pieces.size(); done++)
+    {
+        Piece &piece = pieces[done];
+        size_t left = piece.shared ? piece.shared->size() - piece.begin : piece.end - piece.begin;
+        if (left > n)
+        {
+            piece.begin += n;
+            break;
+        }
+        n -= left;
+    }
+    pieces.erase(pieces.begin(), pieces.begin() + done);
+    if (pieces.empty())
+        clear();
+}
+
+void Session::start(ReplyQueue &out)
+{
+    out.append("Please insert one of the following commands:\n"
+               "Newgraph <n> <m> - Create a new graph with n vertices and m edges, followed by m pairs \"i j\"\n"
+               "Kosaraju [kosaraju|pearce|parallel] [text|ids|deltas] - Print SCCs of the graph\n"
+               "Components [engine] - Count SCCs, edges between them, sources and sinks\n"
+               "Sources [engine] / Sinks [engine] - Print the SCCs no other SCC enters / leaves\n"
+               "Reach <i> <j> [engine] - Check for a path from vertex i to vertex j\n"
+               "Newedge <i> <j> - Add edge from vertex i to vertex j\n"
+               "Removeedge <i> <j> - Remove edge from vertex i to vertex j\n"
+               "Batch <k> - Apply k operations at once, each \"+ i j\" (add) or \"- i j\" (remove)\n");
+}
+
+void Session::feed(const char *data, size_t n, ReplyQueue &out)
+{
+    in.append(data, n);
+
+    while (true)
+    {
+        if (state != State::Command)
+        {
+            if (!readPayload(out))
+                break;
+            continue;
+        }
+
+        size_t newline = in.find('\n', pos);
+        if (newline == string::npos)
+        {
+            if (skipLine)
+                pos = in.size();
+            else if (in.size() - pos > MAX_LINE)
+            {
+                out.append("Invalid command\n");
+                skipLine = true;
+                pos = in.size();
+            }
+            break;
+        }
+
+        string line = in.substr(pos, newline - pos);
+        pos = newline + 1;
+        if (skipLine)
+            skipLine = false;
+        else
+            runCommand(line, out);
+    }
+
+    // Keep only the unparsed tail, without moving it on every read
+    if (pos == in.size())
+    {
+        in.clear();
+        pos = 0;
+    }
+    else if (pos > in.size() / 2)
+    {
+        in.erase(0, pos);
+        pos = 0;
+    }
+}
+
+// Next whitespace-terminated token of the payload. A token running to the end
+// of what has arrived may still be cut off, so it waits for the next read,
+// which only scans the bytes that are new.
+bool Session::nextToken(string &token)
+{
+    while (scanned == 0 && pos < in.size() && isspace((unsigned char)in[pos]))
+        pos++;
+    size_t end = pos + scanned;
+    while (end < in.size() && !isspace((unsigned char)in[end]))
+        end++;
+    if (end == in.size())
+    {
+        scanned = end - pos;
+        return false;
+    }
+    token.assign(in, pos, end - pos);
+    pos = end;
+    scanned = 0;
+    return true;
+}
+
+// Switch to reading a payload of count items, starting right after the header
+// fields already taken from line by iss
+void Session::startPayload(State next, int count, const string &line, istringstream &iss)
+{
+    streamoff consumed = iss.tellg();
+    pos -= line.size() + 1;
+    pos += consumed < 0 ? line.size() : (size_t)consumed;
+    state = next;
+    expected = count;
+    field = 0;
+    valid = true;
+    ops.clear();
+}
+
+// Consume payload tokens of the Newgraph or Batch being read. True once the
+// payload is done with (complete or rejected), false when input runs out first.
+bool Session::readPayload(ReplyQueue &out)
+{
+    string token;
+    while (expected > 0)
+    {
+        if (!nextToken(token))
+        {
+            // A token that outgrows MAX_LINE is malformed; what is left of it is skipped
+            if (scanned <= MAX_LINE)
+                return false;
+            break;
+        }
+
+        if (state == State::Batch && field == 0)
+        {
+            if (token != "+" && token != "-")
+                break;
+            op.add = token == "+";
+        }
+        else
+        {
+            char *end;
+            long value = strtol(token.c_str(), &end, 10);
+            if (*end || value < 1 || value > INT_MAX)
+                break;
+            int vertex = (int)value - 1;
+            if (state == State::Edges)
+            {
+                // A vertex outside the new graph spoils it, but the payload is still read to its end
+                valid = valid && vertex < created->vertices();
+                (field == 0 ? op.v : op.w) = vertex;
+            }
+            else
+                (field == 1 ? op.v : op.w) = vertex;
+        }
+
+        if (++field < (state == State::Edges ? 2 : 3))
+            continue;
+        field = 0;
+        expected--;
+        if (state == State::Edges)
+        {
+            // Applied in slices: the graph isn't shared yet, and the slice stays small
+            op.add = true;
+            if (valid)
+                ops.push_back(op);
+            if (ops.size() >= EDGE_SLICE)
+            {
+                created->loadEdges(ops);
+                ops.clear();
+            }
+        }
+        else
+            ops.push_back(op);
+    }
+
+    if (expected > 0)
+    {
+        // Malformed token: the rest of its line is dropped along with the payload
+        out.append(state == State::Edges ? "Invalid graph\n" : "Invalid batch\n");
+        ops.clear();
+        created.reset();
+        state = State::Command;
+        skipLine = true;
+        scanned = 0;
+        return true;
+    }
+
+    finishPayload(out);
+    return true;
+}
+
+void Session::finishPayload(ReplyQueue &out)
+{
+    if (state == State::Edges)
+    {
+        if (valid)
+        {
+            created->loadEdges(ops);
+            int n = created->vertices();
+
+            // Only the swap needs the lock
+            pthread_mutex_lock(&mtx);
+            Graph *old = g;
+            g = created.release();
+            pthread_mutex_unlock(&mtx);
+            delete old;
+            cout << "New graph created with " << n << " vertices." << endl;
+            out.append("Created new graph\n");
+        }
+        else
+            out.append("Invalid graph\n");
+    }
+    else
+    {
+        // Checked up front, so a batch is applied whole or not at all
+        pthread_mutex_lock(&mtx);
+        if (!g)
+        {
+            pthread_mutex_unlock(&mtx);
+            out.append("No graph created yet.\n");
+        }
+        else
+        {
+            bool batchValid = true;
+            for (const EdgeOp &op : ops)
+                batchValid = batchValid && op.v < g->vertices() && op.w < g->vertices();
+            if (batchValid)
+                g->applyBatch(ops);
+            pthread_mutex_unlock(&mtx);
+            out.append(batchValid ? "Batch applied\n" : "Invalid batch\n");
+        }
+    }
+
+    ops.clear();
+    created.reset();
+    state = State::Command;
+}
+
+void Session::runCommand(const string &line, ReplyQueue &out)
+{
+    istringstream iss(line);
+    string command;
+    if (!(iss >> command))
+        return; // Blank line
+
+    if (command == "Newgraph")
+    {
+        int n = 0, m = -1;
+        iss >> n >> m;
+        if (n < 1 || m < 0)
+        {
+            out.append("Invalid graph\n");
+            return;
+        }
+
+        // The edges may follow on this line or on any number of later ones
+        created.reset(new Graph(n, dedupEdges));
+        startPayload(State::Edges, m, line, iss);
+        if (m == 0)
+            finishPayload(out);
+    }
+    else if (command == "Kosaraju")
+    {
+        string engineName, formatName;
+        SCCEngine engine;
+        OutputFormat format;
+        iss >> engineName >> formatName;
+        if (!parseEngine(engineName, engine))
+        {
+            out.append("Unknown SCC engine\n");
+            return;
+        }
+        if (!parseFormat(formatName, format))
+        {
+            out.append("Unknown output format\n");
+            return;
+        }
+
+        pthread_mutex_lock(&mtx);
+        if (g)
+        {
+            // Usually the cached bytes; they stay valid after the lock is released
+            shared_ptr<const OutputBuffer> result = g->sccResult(engine, format);
+
+            // Check and notify about large SCC
+            bool conditionMet = g->isLargeSCC(engine);
+            notificationQueue.push(conditionMet);
+            pthread_cond_signal(&cv);
+
+            pthread_mutex_unlock(&mtx);
+            cout << "Kosaraju's algorithm executed." << endl;
+            out.share(move(result));
+        }
+        else
+        {
+            pthread_mutex_unlock(&mtx);
+            out.append("No graph created yet.\n");
+        }
+    }
+    else if (command == "Components" || command == "Sources" || command == "Sinks")
+    {
+        string engineName;
+        SCCEngine engine;
+        iss >> engineName;
+        if (!parseEngine(engineName, engine))
+        {
+            out.append("Unknown SCC engine\n");
+            return;
+        }
+        DAGQuery query = command == "Components" ? DAGQuery::Summary
+                         : command == "Sources"  ? DAGQuery::Sources
+                                                 : DAGQuery::Sinks;
+
+        // Answered from the component DAG, which is only rebuilt after a mutation
+        shared_ptr<OutputBuffer> result = make_shared<OutputBuffer>();
+        pthread_mutex_lock(&mtx);
+        if (g)
+        {
+            g->printCondensation(*result, query, engine);
+            pthread_mutex_unlock(&mtx);
+            out.share(move(result));
+        }
+        else
+        {
+            pthread_mutex_unlock(&mtx);
+            out.append("No graph created yet.\n");
+        }
+    }
+    else if (command == "Reach")
+    {
+        int i = 0, j = 0;
+        string engineName;
+        SCCEngine engine;
+        iss >> i >> j >> engineName;
+        if (!parseEngine(engineName, engine))
+        {
+            out.append("Unknown SCC engine\n");
+            return;
+        }
+
+        pthread_mutex_lock(&mtx);
+        if (!g)
+        {
+            pthread_mutex_unlock(&mtx);
+            out.append("No graph created yet.\n");
+        }
+        else if (i < 1 || j < 1 || i > g->vertices() || j > g->vertices())
+        {
+            pthread_mutex_unlock(&mtx);
+            out.append("Invalid vertex\n");
+        }
+        else
+        {
+            // The labels are rebuilt only by the first query after a mutation
+            bool reachable = g->canReach(i - 1, j - 1, engine);
+            pthread_mutex_unlock(&mtx);
+            out.append(reachable ? "Reachable\n" : "Not reachable\n");
+        }
+    }
+    else if (command == "Newedge" || command == "Removeedge")
+    {
+        int i = 0, j = 0;
+        iss >> i >> j;
+        pthread_mutex_lock(&mtx);
+        if (!g)
+        {
+            pthread_mutex_unlock(&mtx);
+            out.append("No graph created yet.\n");
+        }
+        else if (i < 1 || j < 1 || i > g->vertices() || j > g->vertices())
+        {
+            pthread_mutex_unlock(&mtx);
+            out.append("Invalid vertex\n");
+        }
+        else
+        {
+            if (command == "Newedge")
+                g->addEdge(i - 1, j - 1);
+            else
+                g->removeEdge(i - 1, j - 1);
+            pthread_mutex_unlock(&mtx);
+            out.append(command == "Newedge" ? "Edge added\n" : "Edge removed\n");
+        }
+    }
+    else if (command == "Batch")
+    {
+        int count = 0;
+        iss >> count;
+        if (count < 1)
+        {
+            out.append("Invalid batch\n");
+            return;
+        }
+
+        // Like Newgraph, the operations may start on this line
+        startPayload(State::Batch, count, line, iss);
+        ops.reserve(min(count, 1 << 20));
+    }
+    else
+    {
+        out.append("Invalid command\n");
+    }
+}
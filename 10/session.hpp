@@ -0,0 +1,99 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <pthread.h>
+#include <sys/uio.h>
+#include "graph.hpp"
+#include "scc_output.hpp"
+
+using namespace std;
+
+// Server state shared by every connection, defined in server.cpp
+extern Graph *g;
+extern bool dedupEdges;
+extern pthread_mutex_t mtx; // Guards g and notificationQueue
+extern pthread_cond_t cv;
+extern queue<bool> notificationQueue;
+
+// Bytes owed to one client, in order: text written by the command handlers and
+// SCC results shared with the graph's cache, which are sent without a copy
+class ReplyQueue
+{
+public:
+    void append(const char *data, size_t n);
+    void append(const string &text) { append(text.data(), text.size()); }
+    void share(shared_ptr<const OutputBuffer> buffer);
+
+    bool empty() const { return pieces.empty(); }
+    size_t size() const { return bytes; } // Bytes queued, shared ones included
+    void clear();
+
+    // iovecs over everything queued; valid until the queue is changed
+    void gather(vector<iovec> &iov) const;
+    // Blocking write of everything queued, which is then cleared
+    bool writeTo(int fd);
+    // Non-blocking write of what fd takes now; only the unsent rest stays queued
+    bool writeSome(int fd);
+
+private:
+    struct Piece
+    {
+        shared_ptr<const OutputBuffer> shared; // Minus its first begin bytes, already sent
+        size_t begin, end;                     // Or, when shared is null, text[begin, end)
+    };
+
+    void consume(size_t n);
+
+    string text;
+    vector<Piece> pieces;
+    size_t bytes = 0;
+};
+
+// Protocol state of one connection. Bytes go in as they arrive, split or
+// coalesced however TCP delivered them; every command completed by them runs
+// and appends its reply. All server backends drive the same Session.
+class Session
+{
+public:
+    // Queue the greeting with the list of commands
+    void start(ReplyQueue &out);
+    void feed(const char *data, size_t n, ReplyQueue &out);
+
+    static const size_t MAX_LINE = 1 << 16;  // Longer command lines and payload tokens are rejected
+    static const size_t EDGE_SLICE = 4096;   // Newgraph edges added to the new graph at a time
+
+private:
+    enum class State
+    {
+        Command, // Waiting for a command line
+        Edges,   // Reading the "i j" pairs that follow Newgraph
+        Batch    // Reading the "+ i j" / "- i j" operations that follow Batch
+    };
+
+    string in;      // Received, not yet parsed; in[pos..] is pending
+    size_t pos = 0;
+    size_t scanned = 0;    // Bytes of the cut-off payload token at pos already known to hold no whitespace
+    State state = State::Command;
+    bool skipLine = false; // Discard input up to the next newline
+
+    // Payload of the Newgraph or Batch being read
+    int expected = 0;               // Edges or operations still to come
+    int field = 0;                  // Fields of the current edge or operation already read
+    EdgeOp op = {};
+    vector<EdgeOp> ops;
+    unique_ptr<Graph> created;      // Graph under construction, swapped in once complete
+    bool valid = true;
+
+    bool nextToken(string &token);
+    void runCommand(const string &line, ReplyQueue &out);
+    void startPayload(State next, int count, const string &line, istringstream &iss);
+    bool readPayload(ReplyQueue &out);
+    void finishPayload(ReplyQueue &out);
+};
+
+#endif // SESSION_HPP
@@ -0,0 +1,388 @@
+#include "uring_proactor.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+namespace
+{
+    // user_data of every request: the fd, the index of a send within its chain, and the operation
+    uint64_t tag(int fd, unsigned index, uint64_t op)
+    {
+        return (uint64_t)fd << 8 | index << 2 | op;
+    }
+}
+
+UringProactor::UringProactor(unsigned entries)
+{
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    // Only this thread submits, and completions need no interrupt to be posted
+    p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    ringFd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (ringFd < 0 && errno == EINVAL)
+    {
+        // Kernel older than those flags
+        memset(&p, 0, sizeof(p));
+        ringFd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    }
+    if (ringFd < 0)
+        throw runtime_error(string("io_uring_setup: ") + strerror(errno));
+
+    sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single)
+        sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    cqRing = single ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+    void *sqeMemory = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeMemory == MAP_FAILED)
+    {
+        int error = errno;
+        if (sqRing != MAP_FAILED)
+            munmap(sqRing, sqRingSize);
+        if (!single && cqRing != MAP_FAILED)
+            munmap(cqRing, cqRingSize);
+        if (sqeMemory != MAP_FAILED)
+            munmap(sqeMemory, sqesSize);
+        close(ringFd);
+        throw runtime_error(string("io_uring mmap: ") + strerror(error));
+    }
+    sqes = (io_uring_sqe *)sqeMemory;
+
+    char *sq = (char *)sqRing;
+    sqHead = (unsigned *)(sq + p.sq_off.head);
+    sqTail = (unsigned *)(sq + p.sq_off.tail);
+    sqMask = *(unsigned *)(sq + p.sq_off.ring_mask);
+    sqEntries = *(unsigned *)(sq + p.sq_off.ring_entries);
+    // SQE i always sits in slot i, so the indirection array is filled once
+    unsigned *array = (unsigned *)(sq + p.sq_off.array);
+    for (unsigned i = 0; i < sqEntries; i++)
+        array[i] = i;
+    sqeTail = submitted = *sqTail;
+
+    char *cq = (char *)cqRing;
+    cqHead = (unsigned *)(cq + p.cq_off.head);
+    cqTail = (unsigned *)(cq + p.cq_off.tail);
+    cqMask = *(unsigned *)(cq + p.cq_off.ring_mask);
+    cqes = (io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // Receive buffers the kernel picks from itself, so an idle connection holds none
+    bufRingSize = BUFFERS * sizeof(io_uring_buf);
+    void *ringMemory = mmap(nullptr, bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)ringMemory;
+    reg.ring_entries = BUFFERS;
+    reg.bgid = 0;
+    if (ringMemory == MAP_FAILED || syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        int error = errno;
+        if (ringMemory != MAP_FAILED)
+            munmap(ringMemory, bufRingSize);
+        munmap(sqes, sqesSize);
+        if (cqRing != sqRing)
+            munmap(cqRing, cqRingSize);
+        munmap(sqRing, sqRingSize);
+        close(ringFd);
+        throw runtime_error(string("io_uring provided buffers: ") + strerror(error));
+    }
+    bufRing = (io_uring_buf_ring *)ringMemory;
+    buffers.reset(new char[(size_t)BUFFERS * BUFFER_SIZE]);
+    for (unsigned bid = 0; bid < BUFFERS; bid++)
+        recycleBuffer(bid);
+}
+
+UringProactor::~UringProactor()
+{
+    for (auto &c : connections)
+        if (c)
+            close(c->fd);
+    close(ringFd); // Also drops the buffer ring registration
+    munmap(bufRing, bufRingSize);
+    munmap(sqes, sqesSize);
+    if (cqRing != sqRing)
+        munmap(cqRing, cqRingSize);
+    munmap(sqRing, sqRingSize);
+}
+
+io_uring_sqe *UringProactor::getSqe()
+{
+    reserve(1);
+    io_uring_sqe *sqe = &sqes[sqeTail++ & sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// Make room for count SQEs in a row, so a linked chain is never split across submissions
+void UringProactor::reserve(unsigned count)
+{
+    if (sqEntries - (sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE)) < count)
+        submit(0);
+}
+
+int UringProactor::submit(unsigned waitFor)
+{
+    __atomic_store_n(sqTail, sqeTail, __ATOMIC_RELEASE);
+    int ret = (int)syscall(__NR_io_uring_enter, ringFd, sqeTail - submitted, waitFor,
+                           waitFor ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+    if (ret > 0)
+        submitted += ret;
+    return ret;
+}
+
+// Hand buffer bid back to the kernel
+void UringProactor::recycleBuffer(unsigned bid)
+{
+    // Field by field: the ring's tail shares its bytes with the first entry. The
+    // entries start at the ring itself (the header's bufs[] lands elsewhere in C++).
+    io_uring_buf *buf = (io_uring_buf *)bufRing + (bufTail & (BUFFERS - 1));
+    buf->addr = (uint64_t)(buffers.get() + (size_t)bid * BUFFER_SIZE);
+    buf->len = BUFFER_SIZE;
+    buf->bid = (unsigned short)bid;
+    bufTail++;
+    __atomic_store_n(&bufRing->tail, bufTail, __ATOMIC_RELEASE);
+}
+
+void UringProactor::armAccept(int serverSocket)
+{
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = serverSocket;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    if (multishotAccept)
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = tag(serverSocket, 0, Accept);
+}
+
+void UringProactor::armRecv(Connection &c)
+{
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c.fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    if (multishotRecv)
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = tag(c.fd, 0, Recv);
+    c.recvArmed = true;
+}
+
+// Start sending what is queued, unless a send is still in flight: replies
+// leave in the order they were produced
+void UringProactor::flush(Connection &c)
+{
+    if (c.broken || c.sendsInFlight > 0)
+        return;
+    if (c.iovSent == c.iov.size())
+    {
+        c.sending.clear();
+        c.iov.clear();
+        c.iovSent = 0;
+        if (c.pending.empty())
+            return;
+        swap(c.pending, c.sending);
+        c.sending.gather(c.iov);
+        if (c.iov.empty())
+            return;
+    }
+
+    // One sendmsg per IOV_MAX iovecs, linked so the kernel runs them in order.
+    // MSG_WAITALL makes it finish a short send itself instead of breaking the chain.
+    reserve(MAX_LINKED);
+    io_uring_sqe *previous = nullptr;
+    unsigned chain = 0;
+    while (chain < MAX_LINKED && c.iovSent < c.iov.size())
+    {
+        size_t count = min(c.iov.size() - c.iovSent, (size_t)IOV_MAX);
+        msghdr &msg = c.msgs[chain];
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &c.iov[c.iovSent];
+        msg.msg_iovlen = count;
+        c.msgBytes[chain] = 0;
+        for (size_t i = 0; i < count; i++)
+            c.msgBytes[chain] += c.iov[c.iovSent + i].iov_len;
+
+        if (previous)
+            previous->flags |= IOSQE_IO_LINK;
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = c.fd;
+        sqe->addr = (uint64_t)&msg;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+        sqe->user_data = tag(c.fd, chain, Send);
+        previous = sqe;
+
+        c.iovSent += count;
+        chain++;
+    }
+    c.sendsInFlight = chain;
+}
+
+// Stop reading from a client whose replies pile up faster than it takes them,
+// so a client that never reads can't make the server buffer without limit, and
+// read again once the backlog has been handed to a send
+void UringProactor::throttle(Connection &c)
+{
+    bool over = c.pending.size() > MAX_PENDING;
+    if (over && !c.paused)
+    {
+        c.paused = true;
+        // A one-shot recv just isn't rearmed; a multishot one has to be cancelled
+        if (c.recvArmed && multishotRecv)
+        {
+            io_uring_sqe *sqe = getSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = tag(c.fd, 0, Recv);
+            sqe->user_data = tag(c.fd, 0, Cancel);
+        }
+    }
+    else if (!over && c.paused)
+    {
+        c.paused = false;
+        if (!c.recvArmed && !c.eof && !c.broken)
+            armRecv(c);
+    }
+}
+
+// Close the connection once nothing is in flight and nothing more can be sent
+void UringProactor::settle(Connection &c)
+{
+    if (c.recvArmed || c.sendsInFlight > 0)
+        return;
+    if (!c.broken)
+    {
+        // The client only shut down its side: it still gets the replies
+        flush(c);
+        if (c.sendsInFlight > 0)
+            return;
+    }
+
+    int fd = c.fd;
+    close(fd);
+    connections[fd].reset();
+    cout << "Client disconnected." << endl;
+}
+
+void UringProactor::onAccept(int serverSocket, const io_uring_cqe &cqe)
+{
+    if (cqe.res >= 0)
+    {
+        int fd = cqe.res;
+        if (fd >= (int)connections.size())
+            connections.resize(fd + 1);
+        connections[fd].reset(new Connection());
+        Connection &c = *connections[fd];
+        c.fd = fd;
+        c.msgs.resize(MAX_LINKED);
+        c.msgBytes.resize(MAX_LINKED);
+        cout << "Client connected: " << fd << endl;
+
+        c.session.start(c.pending);
+        armRecv(c);
+        flush(c);
+    }
+    else if (cqe.res == -EINVAL && multishotAccept)
+        multishotAccept = false; // Kernel before 5.19: one accept per request
+    else
+        cerr << "accept: " << strerror(-cqe.res) << endl;
+
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+        armAccept(serverSocket);
+}
+
+void UringProactor::onRecv(Connection &c, const io_uring_cqe &cqe)
+{
+    if (cqe.res > 0)
+    {
+        unsigned bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        c.session.feed(buffers.get() + (size_t)bid * BUFFER_SIZE, cqe.res, c.pending);
+        recycleBuffer(bid);
+        flush(c);
+        throttle(c);
+    }
+
+    // Without F_MORE the recv is over: rearm it unless the client is gone
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+    {
+        c.recvArmed = false;
+        if (cqe.res == 0)
+            c.eof = true;
+        else if (cqe.res == -EINVAL && multishotRecv)
+            multishotRecv = false; // Kernel before 6.0: one recv per request
+        else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED)
+            c.broken = true;
+
+        if (!c.eof && !c.broken && !c.paused)
+            armRecv(c);
+    }
+    settle(c);
+}
+
+void UringProactor::onSend(Connection &c, unsigned index, const io_uring_cqe &cqe)
+{
+    c.sendsInFlight--;
+
+    // An error fails the rest of the chain with -ECANCELED; either way the client is lost
+    if ((cqe.res < 0 || (size_t)cqe.res < c.msgBytes[index]) && !c.broken)
+    {
+        c.broken = true;
+        shutdown(c.fd, SHUT_RDWR); // Ends the recv too
+    }
+
+    if (c.sendsInFlight == 0)
+    {
+        flush(c);
+        throttle(c);
+    }
+    settle(c);
+}
+
+void UringProactor::run(int serverSocket)
+{
+    armAccept(serverSocket);
+
+    while (true)
+    {
+        // Submits everything queued since the last round and waits for a completion
+        if (submit(1) < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+        {
+            perror("io_uring_enter");
+            return;
+        }
+
+        unsigned head = *cqHead;
+        while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+        {
+            io_uring_cqe cqe = cqes[head & cqMask];
+            __atomic_store_n(cqHead, ++head, __ATOMIC_RELEASE);
+
+            int fd = (int)(cqe.user_data >> 8);
+            uint64_t op = cqe.user_data & 3;
+            if (op == Accept)
+            {
+                onAccept(fd, cqe);
+                continue;
+            }
+            if (op == Cancel)
+                continue; // The cancelled recv reports on its own
+
+            Connection *c = fd < (int)connections.size() ? connections[fd].get() : nullptr;
+            if (!c)
+                continue;
+            if (op == Recv)
+                onRecv(*c, cqe);
+            else
+                onSend(*c, (unsigned)(cqe.user_data >> 2) & 63, cqe);
+        }
+    }
+}
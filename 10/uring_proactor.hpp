@@ -0,0 +1,106 @@
+#ifndef URING_PROACTOR_HPP
+#define URING_PROACTOR_HPP
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+#include "session.hpp"
+
+using namespace std;
+
+// Completion-based server loop on io_uring, driven through the raw syscalls.
+// One multishot accept takes every connection; each connection has one
+// multishot recv that fills buffers from a ring registered with the kernel,
+// and its replies leave as linked sendmsg requests. One thread serves any
+// number of clients, and a single io_uring_enter submits and reaps a whole
+// round of work.
+class UringProactor
+{
+public:
+    // Throws runtime_error when the kernel lacks io_uring or provided buffer rings
+    explicit UringProactor(unsigned entries = 256);
+    ~UringProactor();
+    UringProactor(const UringProactor &) = delete;
+    UringProactor &operator=(const UringProactor &) = delete;
+
+    // Serve clients of serverSocket; returns only if the ring fails
+    void run(int serverSocket);
+
+    static const unsigned BUFFERS = 256;        // Receive buffers in the ring, a power of 2
+    static const unsigned BUFFER_SIZE = 16384;  // Bytes per receive buffer
+    static const unsigned MAX_LINKED = 16;      // sendmsg requests per linked chain
+    static const size_t MAX_PENDING = 1 << 20;  // Reply bytes queued behind a send before recv stops
+
+private:
+    enum Op : uint64_t
+    {
+        Accept,
+        Recv,
+        Send,
+        Cancel
+    };
+
+    struct Connection
+    {
+        int fd;
+        Session session;
+        ReplyQueue pending;  // Replies produced while a send is in flight
+        ReplyQueue sending;  // Replies the kernel is sending; owns the bytes iov points into
+        vector<iovec> iov;   // sending, gathered; [iovSent, end) not yet submitted
+        size_t iovSent = 0;
+        vector<msghdr> msgs; // One per request of the current chain
+        vector<size_t> msgBytes;
+        unsigned sendsInFlight = 0;
+        bool recvArmed = false;
+        bool paused = false; // Too many replies pending: recv stays off until they go out
+        bool eof = false;    // The client shut down its side; replies still go out
+        bool broken = false; // A send failed; nothing more goes out
+    };
+
+    int ringFd = -1;
+
+    // Submission queue, shared with the kernel
+    void *sqRing = nullptr;
+    size_t sqRingSize = 0;
+    unsigned *sqHead, *sqTail, sqMask, sqEntries;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqesSize = 0;
+    unsigned sqeTail = 0;     // Next free SQE; published to *sqTail by submit
+    unsigned submitted = 0;   // Tail as of the last io_uring_enter
+
+    // Completion queue, shared with the kernel
+    void *cqRing = nullptr;
+    size_t cqRingSize = 0;
+    unsigned *cqHead, *cqTail, cqMask;
+    io_uring_cqe *cqes;
+
+    // Provided buffer ring (group 0) and the memory behind it
+    io_uring_buf_ring *bufRing = nullptr;
+    size_t bufRingSize = 0;
+    unique_ptr<char[]> buffers;
+    unsigned short bufTail = 0;
+
+    bool multishotAccept = true; // Cleared when the kernel turns either one down
+    bool multishotRecv = true;
+
+    vector<unique_ptr<Connection>> connections; // Indexed by fd
+
+    io_uring_sqe *getSqe();
+    void reserve(unsigned count);
+    int submit(unsigned waitFor);
+    void recycleBuffer(unsigned bid);
+
+    void armAccept(int serverSocket);
+    void armRecv(Connection &c);
+    void flush(Connection &c);
+    void throttle(Connection &c);
+    void settle(Connection &c);
+
+    void onAccept(int serverSocket, const io_uring_cqe &cqe);
+    void onRecv(Connection &c, const io_uring_cqe &cqe);
+    void onSend(Connection &c, unsigned index, const io_uring_cqe &cqe);
+};
+
+#endif // URING_PROACTOR_HPP
@@ -0,0 +1,50 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <unistd.h>
+#include "csr_graph.hpp"
+#include "edge_reader.hpp"
+
+using namespace std;
+
+// Convert a text edge list on stdin into the binary CSR format read by kosaraju_csr
+int main(int argc, char *argv[])
+{
+    bool transpose = false, dedup = false;
+    int arg = 1;
+    for (; arg < argc - 1; arg++)
+    {
+        string flag = argv[arg];
+        if (flag == "-t")
+            transpose = true;
+        else if (flag == "-d")
+            dedup = true;
+        else
+            break;
+    }
+    if (arg != argc - 1)
+    {
+        cerr << "Usage: " << argv[0] << " [-t] [-d] graph.bin < graph.txt" << endl;
+        cerr << "  -t  also store the transpose, so Kosaraju and the parallel engine skip building it" << endl;
+        cerr << "  -d  drop parallel edges; every row is stored sorted" << endl;
+        return 1;
+    }
+
+    EdgeReader reader;
+    int vertices, edges;
+    if (!reader.open(STDIN_FILENO) || !reader.readHeader(vertices, edges))
+    {
+        cerr << "Invalid input" << endl;
+        return 1;
+    }
+
+    vector<int> src, dest;
+    reader.readEdges(edges, src, dest);
+    Graph g(vertices, src, dest, dedup);
+
+    if (!g.save(argv[arg], transpose))
+        return 1;
+
+    cout << "Wrote " << g.vertices() << " vertices and " << g.edges() << " edges to " << argv[arg] << endl;
+    return 0;
+}
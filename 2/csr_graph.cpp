@@ -0,0 +1,630 @@
+#include "csr_graph.hpp"
+#include "parallel_scc.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <numeric>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool parseEngine(const string &name, SCCEngine &engine)
+{
+    if (name.empty() || name == "kosaraju")
+        engine = SCCEngine::Kosaraju;
+    else if (name == "pearce" || name == "tarjan")
+        engine = SCCEngine::Pearce;
+    else if (name == "parallel")
+        engine = SCCEngine::Parallel;
+    else
+        return false;
+    return true;
+}
+
+Graph::Graph(int V) : V(V), E(0), ownOffsets(V + 1, 0)
+{
+    adopt();
+}
+
+void Graph::adopt()
+{
+    offsets = ownOffsets.data();
+    targets = ownTargets.data();
+    E = (int)ownTargets.size();
+}
+
+Graph::Graph(int V, const vector<int> &src, const vector<int> &dest, bool dedup, int threads) : V(V)
+{
+    if (dedup)
+    {
+        buildDeduplicated(src, dest, threads);
+        adopt();
+        return;
+    }
+
+    size_t E = src.size();
+    vector<int> &offsets = ownOffsets;
+    vector<int> &targets = ownTargets;
+
+    // Count the out-degree of every vertex into offsets[v + 1]
+    offsets.assign(V + 1, 0);
+    for (size_t e = 0; e < E; e++)
+        offsets[src[e] + 1]++;
+
+    // Prefix sum turns the counts into row start positions
+    for (int v = 0; v < V; v++)
+        offsets[v + 1] += offsets[v];
+
+    // Scatter the heads, using offsets[v] as the insertion cursor of row v
+    targets.resize(E);
+    for (size_t e = 0; e < E; e++)
+        targets[offsets[src[e]]++] = dest[e];
+
+    // Every cursor now points at the start of the next row; shift them back
+    for (int v = V; v > 0; v--)
+        offsets[v] = offsets[v - 1];
+    offsets[0] = 0;
+
+    adopt();
+}
+
+// One stable LSD radix pass whose digit is a whole vertex id: reorder the edge
+// ids in `in` by key[e] into out. Every thread counts its own slice of `in`, then
+// scatters it starting each bucket where the same bucket of earlier slices ends.
+static void radixPass(const vector<int> &key, const vector<int> &in, vector<int> &out, int V, int threads)
+{
+    size_t n = in.size();
+    vector<vector<size_t>> start(threads, vector<size_t>(V, 0));
+    auto first = [&](int t)
+    { return n * t / threads; };
+    auto run = [&](auto body)
+    {
+        vector<thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.emplace_back(body, t);
+        body(0);
+        for (thread &w : workers)
+            w.join();
+    };
+
+    run([&](int t)
+        {
+        for (size_t i = first(t); i < first(t + 1); i++)
+            start[t][key[in[i]]]++; });
+
+    size_t pos = 0;
+    for (int k = 0; k < V; k++)
+        for (int t = 0; t < threads; t++)
+        {
+            size_t count = start[t][k];
+            start[t][k] = pos;
+            pos += count;
+        }
+
+    run([&](int t)
+        {
+        for (size_t i = first(t); i < first(t + 1); i++)
+            out[start[t][key[in[i]]]++] = in[i]; });
+}
+
+void Graph::buildDeduplicated(const vector<int> &src, const vector<int> &dest, int threads)
+{
+    size_t E = src.size();
+    vector<int> &offsets = ownOffsets;
+    vector<int> &targets = ownTargets;
+
+    // Every thread carries a V-entry histogram; stop adding threads once those
+    // would outweigh the edges, and stay serial for small inputs
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    if (E < (1 << 20))
+        threads = 1;
+    threads = (int)max<size_t>(1, min<size_t>(threads, E / max(V, 1)));
+
+    // Sort by head, then stably by tail: each row comes out in ascending order
+    vector<int> order(E), byHead(E);
+    iota(order.begin(), order.end(), 0);
+    radixPass(dest, order, byHead, V, threads);
+    radixPass(src, byHead, order, V, threads);
+    vector<int>().swap(byHead);
+
+    // Copies of an edge are now adjacent; keep the first of each run
+    offsets.assign(V + 1, 0);
+    targets.resize(E);
+    size_t kept = 0;
+    for (size_t i = 0; i < E; i++)
+    {
+        int e = order[i];
+        if (kept > 0 && src[e] == src[order[i - 1]] && dest[e] == targets[kept - 1])
+            continue;
+        offsets[src[e] + 1]++;
+        targets[kept++] = dest[e];
+    }
+    for (int v = 0; v < V; v++)
+        offsets[v + 1] += offsets[v];
+
+    targets.resize(kept);
+    targets.shrink_to_fit();
+}
+
+bool isBinaryGraph(int fd)
+{
+    struct stat st;
+    CSRFileHeader header;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+           pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+           memcmp(header.magic, CSR_FILE_MAGIC, sizeof(header.magic)) == 0;
+}
+
+bool Graph::save(const string &path, bool withTranspose)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        perror("fopen");
+        return false;
+    }
+
+    CSRFileHeader header;
+    memcpy(header.magic, CSR_FILE_MAGIC, sizeof(header.magic));
+    header.version = CSR_FILE_VERSION;
+    header.flags = withTranspose ? CSR_FILE_TRANSPOSE : 0;
+    header.vertices = V;
+    header.edges = E;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(offsets, sizeof(int), V + 1, file) == (size_t)V + 1 &&
+              fwrite(targets, sizeof(int), E, file) == (size_t)E;
+    if (ok && withTranspose)
+    {
+        Graph gr = getTranspose();
+        ok = fwrite(gr.offsets, sizeof(int), V + 1, file) == (size_t)V + 1 &&
+             fwrite(gr.targets, sizeof(int), E, file) == (size_t)E;
+    }
+    if (!ok)
+        perror("fwrite");
+    if (fclose(file) != 0 && ok)
+    {
+        perror("fclose");
+        ok = false;
+    }
+    return ok;
+}
+
+// Every algorithm indexes straight into the arrays, so a mapped file is only
+// trusted once its offsets climb from 0 to E and every target is a vertex
+static bool validCSR(const int *offsets, const int *targets, int V, int E)
+{
+    if (offsets[0] != 0 || offsets[V] != E)
+        return false;
+    for (int v = 0; v < V; v++)
+        if (offsets[v] > offsets[v + 1])
+            return false;
+    for (int e = 0; e < E; e++)
+        if (targets[e] < 0 || targets[e] >= V)
+            return false;
+    return true;
+}
+
+bool Graph::load(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        perror("fstat");
+        return false;
+    }
+
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        return false;
+    }
+    size_t size = st.st_size;
+    mapping = shared_ptr<const void>(map, [size](const void *p)
+                                     { munmap((void *)p, size); });
+
+    // The header must match, and the file must hold exactly the arrays it announces
+    const CSRFileHeader *header = (const CSRFileHeader *)map;
+    bool transpose = size >= sizeof(*header) && (header->flags & CSR_FILE_TRANSPOSE);
+    if (size < sizeof(*header) || memcmp(header->magic, CSR_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CSR_FILE_VERSION || header->vertices >= INT_MAX || header->edges > INT_MAX ||
+        size != sizeof(*header) + (header->vertices + 1 + header->edges) * sizeof(int) * (transpose ? 2 : 1))
+    {
+        cerr << "Invalid binary graph file" << endl;
+        mapping.reset();
+        return false;
+    }
+
+    V = (int)header->vertices;
+    E = (int)header->edges;
+    offsets = (const int *)(header + 1);
+    targets = offsets + V + 1;
+    if (transpose)
+    {
+        rOffsets = targets + E;
+        rTargets = rOffsets + V + 1;
+    }
+    ownOffsets.clear();
+    ownTargets.clear();
+
+    // Page in the arrays; the check below already reads them end to end
+    madvise(map, size, MADV_WILLNEED);
+    if (!validCSR(offsets, targets, V, E) || (transpose && !validCSR(rOffsets, rTargets, V, E)))
+    {
+        cerr << "Invalid binary graph file" << endl;
+        *this = Graph();
+        return false;
+    }
+    return true;
+}
+
+void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames)
+{
+    // Iterative DFS; each frame is (vertex, position of its next edge in targets)
+    visited[v] = true;
+    frames.push_back({v, offsets[v]});
+
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        if (top.second < offsets[top.first + 1])
+        {
+            int i = targets[top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                frames.push_back({i, offsets[i]});
+            }
+        }
+        else
+        {
+            Deque.push_back(top.first);
+            frames.pop_back();
+        }
+    }
+}
+
+Graph Graph::getTranspose()
+{
+    Graph g(V);
+
+    // A binary file may already carry the transpose; share its mapping
+    if (rOffsets)
+    {
+        g.mapping = mapping;
+        g.offsets = rOffsets;
+        g.targets = rTargets;
+        g.E = E;
+        g.rOffsets = offsets;
+        g.rTargets = targets;
+        return g;
+    }
+
+    // Same counting sort as the constructor, keyed on the edge heads
+    vector<int> &gOffsets = g.ownOffsets;
+    vector<int> &gTargets = g.ownTargets;
+    for (int e = 0; e < E; e++)
+        gOffsets[targets[e] + 1]++;
+
+    for (int v = 0; v < V; v++)
+        gOffsets[v + 1] += gOffsets[v];
+
+    gTargets.resize(E);
+    for (int v = 0; v < V; v++)
+        for (int e = offsets[v]; e < offsets[v + 1]; e++)
+            gTargets[gOffsets[targets[e]]++] = v;
+
+    for (int v = V; v > 0; v--)
+        gOffsets[v] = gOffsets[v - 1];
+    gOffsets[0] = 0;
+
+    g.adopt();
+    return g;
+}
+
+// Collect the vertices reachable from v, in discovery order, into members
+void Graph::DFSUtil(int v, vector<bool> &visited, vector<int> &members, vector<pair<int, int>> &frames)
+{
+    visited[v] = true;
+    members.push_back(v);
+    frames.push_back({v, offsets[v]});
+
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        if (top.second < offsets[top.first + 1])
+        {
+            int i = targets[top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                members.push_back(i);
+                frames.push_back({i, offsets[i]});
+            }
+        }
+        else
+            frames.pop_back();
+    }
+}
+
+// One text line: the members, 1-based and space separated
+static void putComponent(OutputBuffer &out, const int *members, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        out.putInt(members[i] + 1);
+        out.put(' ');
+    }
+    out.put('\n');
+}
+
+void Graph::printSCCs(OutputBuffer &out, SCCEngine engine, int threads, OutputFormat format)
+{
+    bool text = format == OutputFormat::Text;
+
+    if (engine == SCCEngine::Pearce || engine == SCCEngine::Parallel)
+    {
+        vector<int> comp;
+        int count;
+        if (engine == SCCEngine::Pearce)
+        {
+            count = pearceSCC(comp);
+        }
+        else
+        {
+            Graph gr = getTranspose();
+            WorkerPool pool(threads);
+            count = trim(gr, comp);
+            count = parallelSCC({V, offsets, targets}, {V, gr.offsets, gr.targets}, comp, count, pool);
+        }
+
+        if (text)
+            printComponents(comp, count, out);
+        else
+            writeComponents(out, format, comp, count);
+        return;
+    }
+
+    // Trimmed vertices are printed up front and start out visited in both passes
+    Graph gr = getTranspose();
+    vector<int> comp;
+    int count = trim(gr, comp);
+    if (text)
+        printComponents(comp, count, out);
+
+    deque<int> Deque;
+    vector<pair<int, int>> frames; // DFS frames, reused by every traversal below
+    vector<int> members;
+
+    vector<bool> visited(V, false);
+    for (int v = 0; v < V; v++)
+        visited[v] = comp[v] != -1;
+
+    for (int i = 0; i < V; i++)
+        if (visited[i] == false)
+            fillOrder(i, visited, Deque, frames);
+
+    for (int v = 0; v < V; v++)
+        visited[v] = comp[v] != -1;
+
+    while (!Deque.empty())
+    {
+        int v = Deque.back();
+        Deque.pop_back();
+
+        if (!visited[v])
+        {
+            members.clear();
+            gr.DFSUtil(v, visited, members, frames);
+            if (text)
+            {
+                putComponent(out, members.data(), members.size());
+                continue;
+            }
+            for (int w : members)
+                comp[w] = count;
+            count++;
+        }
+    }
+
+    if (!text)
+        writeComponents(out, format, comp, count);
+}
+
+// Trim-1 peels vertices with no live in- or out-edges, which are singleton
+// SCCs, and cascades through the degree counters. Trim-2 then peels 2-cycles
+// with no other live in-edges (or no other live out-edges), followed by
+// another Trim-1 cascade. gr is the transpose, used to walk in-edges.
+// Trimmed vertices get a component id in comp, the rest stay -1.
+// Returns the number of components found.
+int Graph::trim(const Graph &gr, vector<int> &comp)
+{
+    vector<int> inDeg(V), outDeg(V), queue;
+    int count = 0;
+
+    comp.assign(V, -1);
+    for (int v = 0; v < V; v++)
+    {
+        outDeg[v] = offsets[v + 1] - offsets[v];
+        inDeg[v] = gr.offsets[v + 1] - gr.offsets[v];
+        if (inDeg[v] == 0 || outDeg[v] == 0)
+            queue.push_back(v);
+    }
+
+    // Drop the edges of a just assigned vertex from its live neighbours' counters
+    auto detach = [&](int v)
+    {
+        for (int e = offsets[v]; e < offsets[v + 1]; e++)
+        {
+            int w = targets[e];
+            if (comp[w] == -1 && --inDeg[w] == 0)
+                queue.push_back(w);
+        }
+        for (int e = gr.offsets[v]; e < gr.offsets[v + 1]; e++)
+        {
+            int u = gr.targets[e];
+            if (comp[u] == -1 && --outDeg[u] == 0)
+                queue.push_back(u);
+        }
+    };
+
+    auto trim1 = [&]()
+    {
+        while (!queue.empty())
+        {
+            int v = queue.back();
+            queue.pop_back();
+            if (comp[v] != -1)
+                continue;
+            comp[v] = count++;
+            detach(v);
+        }
+    };
+
+    // The single live neighbour of v in g, for a vertex whose live degree there is 1
+    auto onlyNeighbour = [&](const Graph &g, int v)
+    {
+        for (int e = g.offsets[v]; e < g.offsets[v + 1]; e++)
+            if (comp[g.targets[e]] == -1)
+                return g.targets[e];
+        return -1;
+    };
+
+    trim1();
+
+    for (int v = 0; v < V; v++)
+    {
+        if (comp[v] != -1)
+            continue;
+
+        int u = -1;
+        if (inDeg[v] == 1)
+        {
+            int w = onlyNeighbour(gr, v);
+            if (w != v && inDeg[w] == 1 && onlyNeighbour(gr, w) == v)
+                u = w;
+        }
+        if (u == -1 && outDeg[v] == 1)
+        {
+            int w = onlyNeighbour(*this, v);
+            if (w != v && outDeg[w] == 1 && onlyNeighbour(*this, w) == v)
+                u = w;
+        }
+        if (u == -1)
+            continue;
+
+        comp[v] = comp[u] = count++;
+        detach(v);
+        detach(u);
+    }
+
+    trim1();
+    return count;
+}
+
+// Pearce's space-efficient Tarjan: one DFS, rindex doubles as lowlink and
+// final component id, plus one root bit per vertex. Components are numbered
+// in the order they complete, i.e. reverse topological order.
+int Graph::pearceSCC(vector<int> &comp)
+{
+    vector<int> &rindex = comp;
+    vector<bool> root(V, false);
+    vector<int> S;                 // Visited vertices not yet assigned to an SCC
+    vector<pair<int, int>> frames; // (vertex, position of its next edge in targets)
+    int index = 1;                 // 0 marks unvisited
+    int c = V - 1;                 // Next component id, counting down
+
+    rindex.assign(V, 0);
+    for (int s = 0; s < V; s++)
+    {
+        if (rindex[s] != 0)
+            continue;
+
+        rindex[s] = index++;
+        root[s] = true;
+        frames.push_back({s, offsets[s]});
+
+        while (!frames.empty())
+        {
+            pair<int, int> &top = frames.back();
+            int v = top.first;
+            if (top.second < offsets[v + 1])
+            {
+                int w = targets[top.second++];
+                if (rindex[w] == 0)
+                {
+                    rindex[w] = index++;
+                    root[w] = true;
+                    frames.push_back({w, offsets[w]});
+                }
+                else if (rindex[w] < rindex[v])
+                {
+                    rindex[v] = rindex[w];
+                    root[v] = false;
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if (root[v])
+            {
+                // v is the root of a component: pop it and its members off S
+                index--;
+                while (!S.empty() && rindex[v] <= rindex[S.back()])
+                {
+                    rindex[S.back()] = c;
+                    S.pop_back();
+                    index--;
+                }
+                rindex[v] = c--;
+            }
+            else
+            {
+                S.push_back(v);
+            }
+
+            // Propagate the lowlink to the parent, as the recursive version does on return
+            if (!frames.empty())
+            {
+                int u = frames.back().first;
+                if (rindex[v] < rindex[u])
+                {
+                    rindex[u] = rindex[v];
+                    root[u] = false;
+                }
+            }
+        }
+    }
+
+    // Renumber so the first completed component is 0
+    for (int v = 0; v < V; v++)
+        comp[v] = V - 1 - rindex[v];
+    return V - 1 - c;
+}
+
+// Print components given as an id per vertex (-1 = not assigned, skipped),
+// highest id first so the reverse topological numbering comes out
+// source-first like Kosaraju
+void Graph::printComponents(const vector<int> &comp, int count, OutputBuffer &out)
+{
+    vector<int> start(count + 1, 0);
+    for (int v = 0; v < V; v++)
+        if (comp[v] >= 0)
+            start[comp[v] + 1]++;
+    for (int c = 0; c < count; c++)
+        start[c + 1] += start[c];
+
+    vector<int> members(start[count]);
+    vector<int> pos(start.begin(), start.end() - 1);
+    for (int v = 0; v < V; v++)
+        if (comp[v] >= 0)
+            members[pos[comp[v]]++] = v;
+
+    for (int c = count - 1; c >= 0; c--)
+        putComponent(out, &members[start[c]], start[c + 1] - start[c]);
+}
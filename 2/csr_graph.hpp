@@ -0,0 +1,99 @@
+#ifndef CSR_GRAPH_HPP
+#define CSR_GRAPH_HPP
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "scc_output.hpp"
+
+using namespace std;
+
+// Algorithms printSCCs can run
+enum class SCCEngine
+{
+    Kosaraju, // Two DFS passes, the second over the transpose
+    Pearce,   // Pearce's single-pass variant of Tarjan, no transpose
+    Parallel  // Multi-threaded forward-backward + coloring
+};
+
+// Parse an engine name given on the command line; an empty name selects Kosaraju
+bool parseEngine(const string &name, SCCEngine &engine);
+
+// Layout of a binary graph file, in host byte order:
+//   CSRFileHeader, offsets[V + 1], targets[E], and when CSR_FILE_TRANSPOSE is
+//   set the transpose's offsets[V + 1] and targets[E]. Every array is int32.
+const char CSR_FILE_MAGIC[8] = {'K', 'S', 'R', 'C', 'S', 'R', '\0', '\0'};
+const uint32_t CSR_FILE_VERSION = 1;
+const uint32_t CSR_FILE_TRANSPOSE = 1; // Flag: the transpose follows the graph
+
+struct CSRFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t vertices;
+    uint64_t edges;
+};
+
+// True if fd is a regular file that starts with a binary graph header.
+// Reads with pread, so a text input is left untouched.
+bool isBinaryGraph(int fd);
+
+// Graph class to represent a directed graph in compressed sparse row (CSR) form.
+// The out-edges of vertex v are targets[offsets[v]] .. targets[offsets[v + 1] - 1].
+// The arrays either live in the graph's own vectors or in a mapped binary file.
+class Graph
+{
+    int V;                  // Number of vertices
+    int E;                  // Number of edges
+    const int *offsets;     // Row offsets into targets (V + 1 entries)
+    const int *targets;     // Edge heads, grouped by tail vertex
+    vector<int> ownOffsets; // Storage behind offsets/targets unless mapped
+    vector<int> ownTargets;
+
+    shared_ptr<const void> mapping;      // Keeps a mapped file alive for every graph viewing it
+    const int *rOffsets = nullptr;       // Transpose stored in the mapped file, if any
+    const int *rTargets = nullptr;
+
+    Graph(int V);
+    void adopt(); // Point offsets/targets at the own vectors
+    void buildDeduplicated(const vector<int> &src, const vector<int> &dest, int threads);
+
+    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames);
+    void DFSUtil(int v, vector<bool> &visited, vector<int> &members, vector<pair<int, int>> &frames);
+
+    int trim(const Graph &gr, vector<int> &comp);
+    int pearceSCC(vector<int> &comp);
+    void printComponents(const vector<int> &comp, int count, OutputBuffer &out);
+
+public:
+    Graph() : Graph(0) {}
+
+    // Build the graph from an edge list (0-based) with one counting sort pass.
+    // With dedup every row is sorted and holds each head once; the edges are
+    // then radix sorted on up to threads threads (0 uses every core).
+    Graph(int V, const vector<int> &src, const vector<int> &dest, bool dedup = false, int threads = 0);
+
+    // Views into the vectors must follow them, so moves only
+    Graph(Graph &&) = default;
+    Graph &operator=(Graph &&) = default;
+    Graph(const Graph &) = delete;
+    Graph &operator=(const Graph &) = delete;
+
+    int vertices() const { return V; }
+    int edges() const { return E; }
+
+    // Write the graph in the binary format, optionally with its transpose
+    bool save(const string &path, bool withTranspose);
+    // Map a binary graph file and use its arrays in place
+    bool load(int fd);
+
+    // Write the SCCs into out. threads only applies to the parallel engine; 0 uses every core
+    void printSCCs(OutputBuffer &out, SCCEngine engine = SCCEngine::Kosaraju, int threads = 0,
+                   OutputFormat format = OutputFormat::Text);
+    Graph getTranspose();
+};
+
+#endif // CSR_GRAPH_HPP
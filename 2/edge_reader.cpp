@@ -0,0 +1,120 @@
+#include "edge_reader.hpp"
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+EdgeReader::~EdgeReader()
+{
+    if (mappedSize)
+        munmap((void *)data, mappedSize);
+}
+
+bool EdgeReader::open(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            mappedSize = st.st_size;
+            data = pos = (const char *)map;
+            end = data + mappedSize;
+            return true;
+        }
+    }
+
+    // Pipes and terminals: read in 1 MiB blocks
+    const size_t BLOCK = 1 << 20;
+    size_t used = 0;
+    while (true)
+    {
+        buffer.resize(used + BLOCK);
+        ssize_t got = read(fd, buffer.data() + used, BLOCK);
+        if (got < 0)
+            return false;
+        if (got == 0)
+            break;
+        used += got;
+    }
+    buffer.resize(used);
+    data = pos = buffer.data();
+    end = data + used;
+    return true;
+}
+
+int EdgeReader::readEdges(int edges, vector<int> &src, vector<int> &dest, int threads)
+{
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+
+    src.resize(edges);
+    dest.resize(edges);
+
+    // Small inputs aren't worth the threads
+    size_t length = end - pos;
+    if (threads == 1 || length < (1 << 22))
+    {
+        int n = 0;
+        forEachEdge(edges, [&](int s, int d)
+                    { src[n] = s, dest[n] = d, n++; });
+        src.resize(n);
+        dest.resize(n);
+        return n;
+    }
+
+    // Cut the text into one slice per thread, each ending just after a newline
+    vector<const char *> cut(threads + 1);
+    cut[0] = pos;
+    cut[threads] = end;
+    for (int t = 1; t < threads; t++)
+    {
+        const char *p = max(pos + length * t / threads, cut[t - 1]);
+        const char *nl = (const char *)memchr(p, '\n', end - p);
+        cut[t] = nl ? nl + 1 : end;
+    }
+
+    vector<vector<int>> parts(threads);
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back([&, t]()
+                             {
+            const char *p = cut[t];
+            int value;
+            while (scanInt(p, cut[t + 1], value))
+                parts[t].push_back(value); });
+    for (thread &w : workers)
+        w.join();
+
+    // Every line holds one pair, so a slice with an odd count means the input
+    // isn't line-per-edge; start over serially in that case
+    for (const vector<int> &part : parts)
+        if (part.size() % 2)
+            return readEdges(edges, src, dest, 1);
+
+    vector<size_t> first(threads + 1, 0);
+    for (int t = 0; t < threads; t++)
+        first[t + 1] = first[t] + parts[t].size() / 2;
+    int count = (int)min<size_t>(edges, first[threads]);
+
+    workers.clear();
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back([&, t]()
+                             {
+            for (size_t i = 0; i < parts[t].size() / 2 && first[t] + i < (size_t)count; i++)
+            {
+                src[first[t] + i] = parts[t][2 * i] - 1;
+                dest[first[t] + i] = parts[t][2 * i + 1] - 1;
+            } });
+    for (thread &w : workers)
+        w.join();
+
+    pos = end;
+    src.resize(count);
+    dest.resize(count);
+    return count;
+}
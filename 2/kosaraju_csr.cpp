@@ -0,0 +1,62 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <unistd.h>
+#include "csr_graph.hpp"
+#include "edge_reader.hpp"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    SCCEngine engine;
+    OutputFormat format;
+    bool dedup = argc > 4 && string(argv[4]) == "dedup"; // Drop parallel edges of a text input
+    if (!parseEngine(argc > 1 ? argv[1] : "", engine) || !parseFormat(argc > 3 ? argv[3] : "", format) ||
+        (argc > 4 && !dedup))
+    {
+        cerr << "Usage: " << argv[0] << " [kosaraju|pearce|parallel [threads [text|ids|deltas [dedup]]]] < graph.txt|graph.bin" << endl;
+        return 1;
+    }
+    bool text = format == OutputFormat::Text; // Binary output carries no prompts
+    int threads = argc > 2 ? atoi(argv[2]) : 0; // Used by the reader and the parallel engine
+
+    // A binary graph file (see csr_convert) is mapped and used in place
+    Graph g;
+    if (isBinaryGraph(STDIN_FILENO))
+    {
+        if (!g.load(STDIN_FILENO))
+            return 1;
+    }
+    else
+    {
+        EdgeReader reader;
+        int vertices, edges;
+        if (text)
+            cout << "Enter the number of vertices and edges (format: vertices edges): ";
+        if (!reader.open(STDIN_FILENO) || !reader.readHeader(vertices, edges))
+        {
+            cerr << "Invalid input" << endl;
+            return 1;
+        }
+
+        // Collect the whole edge list first so the CSR arrays are allocated once
+        vector<int> src, dest;
+        reader.readEdges(edges, src, dest, threads);
+
+        g = Graph(vertices, src, dest, dedup, threads);
+    }
+
+    if (text)
+        cout << "Strongly Connected Components are:\n";
+    cout << flush;
+
+    // The whole result is formatted in memory and written with one writev
+    OutputBuffer out;
+    g.printSCCs(out, engine, threads, format);
+    if (!out.writeTo(STDOUT_FILENO))
+        return 1;
+
+    return 0;
+}
@@ -2,6 +2,8 @@
 #include <vector>
 #include <deque>
 #include <algorithm>
+#include <unistd.h>
+#include "edge_reader.hpp"
 
 using namespace std;
 
@@ -10,8 +12,8 @@ class Graph
     int V;                   // Number of vertices
     vector<vector<int>> adj; // Adjacency list
 
-    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque);
-    void DFSUtil(int v, vector<bool> &visited);
+    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames);
+    void DFSUtil(int v, vector<bool> &visited, vector<pair<int, int>> &frames);
 
 public:
     Graph(int V);
@@ -31,15 +33,29 @@ void Graph::addEdge(int v, int w)
     adj[v].push_back(w);
 }
 
-void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque)
+void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames)
 {
     visited[v] = true;
+    frames.push_back({v, 0});
 
-    for (int i : adj[v])
-        if (!visited[i])
-            fillOrder(i, visited, Deque);
-
-    Deque.push_back(v);
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)adj[top.first].size())
+        {
+            int i = adj[top.first][top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                frames.push_back({i, 0});
+            }
+        }
+        else
+        {
+            Deque.push_back(top.first);
+            frames.pop_back();
+        }
+    }
 }
 
 Graph Graph::getTranspose()
@@ -53,25 +69,40 @@ Graph Graph::getTranspose()
     return g;
 }
 
-void Graph::DFSUtil(int v, vector<bool> &visited)
+void Graph::DFSUtil(int v, vector<bool> &visited, vector<pair<int, int>> &frames)
 {
     visited[v] = true;
     cout << v + 1 << " ";  // Adjust for 1-based output
+    frames.push_back({v, 0});
 
-    for (int i : adj[v])
-        if (!visited[i])
-            DFSUtil(i, visited);
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)adj[top.first].size())
+        {
+            int i = adj[top.first][top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                cout << i + 1 << " ";
+                frames.push_back({i, 0});
+            }
+        }
+        else
+            frames.pop_back();
+    }
 }
 
 void Graph::printSCCs()
 {
     deque<int> Deque;
+    vector<pair<int, int>> frames; // DFS frames, reused by every traversal below
 
     vector<bool> visited(V, false);
 
     for (int i = 0; i < V; i++)
         if (visited[i] == false)
-            fillOrder(i, visited, Deque);
+            fillOrder(i, visited, Deque, frames);
 
     Graph gr = getTranspose();
 
@@ -84,7 +115,7 @@ void Graph::printSCCs()
 
         if (!visited[v])
         {
-            gr.DFSUtil(v, visited);
+            gr.DFSUtil(v, visited, frames);
             cout << endl;
         }
     }
@@ -92,20 +123,20 @@ void Graph::printSCCs()
 
 int main()
 {
+    EdgeReader reader;
     int vertices, edges;
     cout << "Enter the number of vertices and edges (format: vertices edges): ";
-    cin >> vertices >> edges;
-    // need to validate the input
-
-    Graph g(vertices);
-    for (int i = 0; i < edges; i++)
+    if (!reader.open(STDIN_FILENO) || !reader.readHeader(vertices, edges))
     {
-        //cout << "Enter the source and destination (1-based index): ";
-        int src, dest;
-        cin >> src >> dest;
-        g.addEdge(src - 1, dest - 1); // Adjust for 0-based indexing
+        cerr << "Invalid input" << endl;
+        return 1;
     }
 
+    // The reader hands out 0-based edges straight from its buffer
+    Graph g(vertices);
+    reader.forEachEdge(edges, [&](int src, int dest)
+                       { g.addEdge(src, dest); });
+
     cout << "Strongly Connected Components are:\n";
     //g.printSCCs();
 
@@ -2,16 +2,24 @@
 #include <vector>
 #include <list>
 #include <algorithm>
+#include <unistd.h>
+#include <cstdint>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "edge_reader.hpp"
 
 using namespace std;
 
 class Graph
 {
-    int V;                   // Number of vertices
-    vector<vector<int>> adj; // Adjacency matrix
+    int V;                 // Number of vertices
+    int W;                 // 64-bit words per matrix row
+    vector<uint64_t> adj;  // Adjacency matrix, one bit per cell, row-major
 
-    void fillOrder(int v, vector<bool> &visited, list<int> &List);
-    void DFSUtil(int v, vector<bool> &visited);
+    int nextNeighbour(int v, int &k, const vector<uint64_t> &unvisited);
+    void fillOrder(int v, vector<uint64_t> &unvisited, list<int> &List, vector<pair<int, int>> &frames);
+    void DFSUtil(int v, vector<uint64_t> &unvisited, vector<pair<int, int>> &frames);
 
 public:
     Graph(int V);
@@ -23,23 +31,76 @@ public:
 Graph::Graph(int V)
 {
     this->V = V;
-    adj.resize(V, vector<int>(V, 0)); // Initialize VxV matrix with 0s
+    W = (V + 63) / 64;
+    adj.assign((size_t)V * W, 0); // Initialize VxV bit matrix with 0s
 }
 
 void Graph::addEdge(int v, int w)
 {
-    adj[v][w] = 1;
+    adj[(size_t)v * W + w / 64] |= 1ULL << (w % 64);
 }
 
-void Graph::fillOrder(int v, vector<bool> &visited, list<int> &List)
+// Mark every vertex as not visited; bits past V stay clear so they are never picked
+static void resetUnvisited(vector<uint64_t> &unvisited, int V)
 {
-    visited[v] = true;
+    unvisited.assign((V + 63) / 64, ~0ULL);
+    if (V % 64)
+        unvisited.back() = (1ULL << (V % 64)) - 1;
+}
 
-    for (int i = 0; i < V; i++)
-        if (adj[v][i] && !visited[i])
-            fillOrder(i, visited, List);
+static void markVisited(vector<uint64_t> &unvisited, int v)
+{
+    unvisited[v / 64] &= ~(1ULL << (v % 64));
+}
+
+// Find the first unvisited neighbour of v in row words k and later by ANDing
+// the row with the unvisited bitmap. Returns -1 once the row is exhausted.
+int Graph::nextNeighbour(int v, int &k, const vector<uint64_t> &unvisited)
+{
+    const uint64_t *row = &adj[(size_t)v * W];
+
+#ifdef __AVX2__
+    // Skip 256 columns at a time while nothing is left in them
+    for (; k + 4 <= W; k += 4)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(row + k));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(unvisited.data() + k));
+        if (!_mm256_testz_si256(a, b))
+            break;
+    }
+#endif
+
+    for (; k < W; k++)
+    {
+        uint64_t bits = row[k] & unvisited[k];
+        if (bits)
+            return k * 64 + __builtin_ctzll(bits);
+    }
+    return -1;
+}
+
+// Frames hold (vertex, row word to resume at). Visited neighbours are cleared
+// from the bitmap, so rescanning the current word finds the next one.
+void Graph::fillOrder(int v, vector<uint64_t> &unvisited, list<int> &List, vector<pair<int, int>> &frames)
+{
+    markVisited(unvisited, v);
+    frames.push_back({v, 0});
 
-    List.push_back(v);
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        int i = nextNeighbour(top.first, top.second, unvisited);
+        if (i >= 0)
+        {
+            markVisited(unvisited, i);
+            frames.push_back({i, 0});
+        }
+        else
+        {
+            List.push_back(top.first);
+            frames.pop_back();
+        }
+    }
 }
 
 Graph Graph::getTranspose()
@@ -47,47 +108,61 @@ Graph Graph::getTranspose()
     Graph g(V);
     for (int v = 0; v < V; v++)
     {
-        for (int i = 0; i < V; i++)
+        const uint64_t *row = &adj[(size_t)v * W];
+        for (int k = 0; k < W; k++)
         {
-            if (adj[v][i])
-                g.adj[i][v] = 1;
+            for (uint64_t bits = row[k]; bits; bits &= bits - 1)
+                g.addEdge(k * 64 + __builtin_ctzll(bits), v);
         }
     }
     return g;
 }
 
-void Graph::DFSUtil(int v, vector<bool> &visited)
+void Graph::DFSUtil(int v, vector<uint64_t> &unvisited, vector<pair<int, int>> &frames)
 {
-    visited[v] = true;
+    markVisited(unvisited, v);
     cout << v + 1 << " ";  // Adjust for 1-based output
+    frames.push_back({v, 0});
 
-    for (int i = 0; i < V; i++)
-        if (adj[v][i] && !visited[i])
-            DFSUtil(i, visited);
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        int i = nextNeighbour(top.first, top.second, unvisited);
+        if (i >= 0)
+        {
+            markVisited(unvisited, i);
+            cout << i + 1 << " ";
+            frames.push_back({i, 0});
+        }
+        else
+            frames.pop_back();
+    }
 }
 
 void Graph::printSCCs()
 {
     list<int> List;
+    vector<pair<int, int>> frames; // DFS frames, reused by every traversal below
 
-    vector<bool> visited(V, false);
+    vector<uint64_t> unvisited;
+    resetUnvisited(unvisited, V);
 
     for (int i = 0; i < V; i++)
-        if (!visited[i])
-            fillOrder(i, visited, List);
+        if (unvisited[i / 64] >> (i % 64) & 1)
+            fillOrder(i, unvisited, List, frames);
 
     Graph gr = getTranspose();
 
-    fill(visited.begin(), visited.end(), false);
+    resetUnvisited(unvisited, V);
 
     while (!List.empty())
     {
         int v = List.back();
         List.pop_back();
 
-        if (!visited[v])
+        if (unvisited[v / 64] >> (v % 64) & 1)
         {
-            gr.DFSUtil(v, visited);
+            gr.DFSUtil(v, unvisited, frames);
             cout << endl;
         }
     }
@@ -95,20 +170,20 @@ void Graph::printSCCs()
 
 int main()
 {
+    EdgeReader reader;
     int vertices, edges;
     cout << "Enter the number of vertices and edges (format: vertices edges): ";
-    cin >> vertices >> edges;
-    // need to validate the input
-
-    Graph g(vertices);
-    for (int i = 0; i < edges; i++)
+    if (!reader.open(STDIN_FILENO) || !reader.readHeader(vertices, edges))
     {
-        //cout << "Enter the source and destination (1-based index): ";
-        int src, dest;
-        cin >> src >> dest;
-        g.addEdge(src - 1, dest - 1); // Adjust for 0-based indexing
+        cerr << "Invalid input" << endl;
+        return 1;
     }
 
+    // The reader hands out 0-based edges straight from its buffer
+    Graph g(vertices);
+    reader.forEachEdge(edges, [&](int src, int dest)
+                       { g.addEdge(src, dest); });
+
     cout << "Strongly Connected Components are:\n";
     //g.printSCCs();
 
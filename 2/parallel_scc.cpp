@@ -0,0 +1,389 @@
+#include "parallel_scc.hpp"
+#include <memory>
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threads)
+{
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    for (int id = 1; id < threads; id++)
+        workers.emplace_back(&WorkerPool::workerLoop, this, id);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        lock_guard<mutex> lock(m);
+        stopping = true;
+    }
+    startCv.notify_all();
+    for (thread &t : workers)
+        t.join();
+}
+
+// Grab chunks of the current job until the range is exhausted
+void WorkerPool::runChunks(int id)
+{
+    size_t begin;
+    while ((begin = nextIndex.fetch_add(jobGrain)) < jobSize)
+        (*job)(begin, min(begin + jobGrain, jobSize), id);
+}
+
+void WorkerPool::workerLoop(int id)
+{
+    unsigned long seen = 0;
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(m);
+            startCv.wait(lock, [&]
+                         { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        runChunks(id);
+
+        lock_guard<mutex> lock(m);
+        if (--busy == 0)
+            doneCv.notify_one();
+    }
+}
+
+void WorkerPool::parallelFor(size_t n, size_t grain, const function<void(size_t, size_t, int)> &body)
+{
+    if (n == 0)
+        return;
+
+    // Not worth waking anybody for a single chunk
+    if (workers.empty() || n <= grain)
+    {
+        body(0, n, 0);
+        return;
+    }
+
+    lock_guard<mutex> run(runMutex);
+    {
+        lock_guard<mutex> lock(m);
+        job = &body;
+        jobSize = n;
+        jobGrain = max<size_t>(grain, 1);
+        nextIndex = 0;
+        busy = (int)workers.size();
+        generation++;
+    }
+    startCv.notify_all();
+
+    runChunks(0);
+
+    unique_lock<mutex> lock(m);
+    doneCv.wait(lock, [&]
+                { return busy == 0; });
+    job = nullptr;
+}
+
+namespace
+{
+    const size_t GRAIN = 1024;   // Vertices per chunk in flat loops
+    const size_t FRONTIER = 64;  // Frontier vertices per chunk, each may carry many edges
+    const int ASSIGNED = -1;     // Mark/color of a vertex that already has a component
+    const size_t SERIAL = 4096;  // Below this many vertices coloring rounds don't pay off
+
+    class ParallelSCC
+    {
+        const CSRView &fwd, &bwd;
+        vector<int> &comp;
+        WorkerPool &pool;
+        int V;
+        unique_ptr<atomic<int>[]> mark; // Sweep state (FW-BW) or color (coloring) per vertex
+        unique_ptr<atomic<char>[]> queued;
+        vector<vector<int>> local; // Per worker output buffers
+        atomic<int> nextComp;
+
+        void gather(vector<int> &out);
+        void sweep(const CSRView &g, int src, int from, int to);
+        bool raise(int w, int color);
+
+    public:
+        ParallelSCC(const CSRView &fwd, const CSRView &bwd, vector<int> &comp, int count, WorkerPool &pool)
+            : fwd(fwd), bwd(bwd), comp(comp), pool(pool), V(fwd.V),
+              mark(new atomic<int>[fwd.V]), queued(new atomic<char>[fwd.V]), local(pool.size()), nextComp(count) {}
+
+        void forwardBackward();
+        void coloring();
+        void serialFinish(const vector<int> &remaining);
+        int count() const { return nextComp.load(); }
+    };
+
+    // Move every worker buffer into out
+    void ParallelSCC::gather(vector<int> &out)
+    {
+        out.clear();
+        for (vector<int> &part : local)
+        {
+            out.insert(out.end(), part.begin(), part.end());
+            part.clear();
+        }
+    }
+
+    // Level-synchronous BFS from src. A vertex joins when its mark moves from 'from' to 'to'.
+    void ParallelSCC::sweep(const CSRView &g, int src, int from, int to)
+    {
+        vector<int> frontier(1, src);
+        mark[src].store(to, memory_order_relaxed);
+
+        while (!frontier.empty())
+        {
+            pool.parallelFor(frontier.size(), FRONTIER, [&](size_t begin, size_t end, int worker)
+                             {
+                vector<int> &next = local[worker];
+                for (size_t i = begin; i < end; i++)
+                {
+                    int v = frontier[i];
+                    for (int e = g.offsets[v]; e < g.offsets[v + 1]; e++)
+                    {
+                        int w = g.targets[e];
+                        int expected = from;
+                        if (mark[w].load(memory_order_relaxed) == from &&
+                            mark[w].compare_exchange_strong(expected, to, memory_order_relaxed))
+                            next.push_back(w);
+                    }
+                } });
+            gather(frontier);
+        }
+    }
+
+    // Peel the component of the vertex with the largest in*out degree, which on
+    // power-law graphs is almost always inside the giant SCC
+    void ParallelSCC::forwardBackward()
+    {
+        vector<pair<long long, int>> best(pool.size(), {-1, -1});
+        pool.parallelFor(V, GRAIN, [&](size_t begin, size_t end, int worker)
+                         {
+            for (size_t v = begin; v < end; v++)
+            {
+                mark[v].store(comp[v] == -1 ? 0 : ASSIGNED, memory_order_relaxed);
+                if (comp[v] != -1)
+                    continue;
+                long long score = (long long)(fwd.offsets[v + 1] - fwd.offsets[v]) * (bwd.offsets[v + 1] - bwd.offsets[v]);
+                if (score > best[worker].first)
+                    best[worker] = {score, (int)v};
+            } });
+
+        int pivot = max_element(best.begin(), best.end())->second;
+        if (pivot < 0)
+            return;
+
+        // Forward closure gets mark 1, the backward sweep inside it gets mark 2
+        sweep(fwd, pivot, 0, 1);
+        sweep(bwd, pivot, 1, 2);
+
+        int id = nextComp++;
+        pool.parallelFor(V, GRAIN, [&](size_t begin, size_t end, int)
+                         {
+            for (size_t v = begin; v < end; v++)
+                if (mark[v].load(memory_order_relaxed) == 2)
+                    comp[v] = id; });
+    }
+
+    // Raise the color of w to color unless w is already assigned; true if it changed.
+    // Sequentially consistent so a raise can't slip past the owner clearing queued[w].
+    bool ParallelSCC::raise(int w, int color)
+    {
+        int current = mark[w].load();
+        while (current != ASSIGNED && current < color)
+            if (mark[w].compare_exchange_weak(current, color))
+                return true;
+        return false;
+    }
+
+    // Every remaining vertex takes the largest id that reaches it. A vertex that
+    // keeps its own id is a root, and its SCC is the set of same-colored
+    // vertices that reach it backwards. Repeat on whatever is left.
+    void ParallelSCC::coloring()
+    {
+        vector<int> remaining, frontier, roots;
+        pool.parallelFor(V, GRAIN, [&](size_t begin, size_t end, int worker)
+                         {
+            for (size_t v = begin; v < end; v++)
+            {
+                if (comp[v] == -1)
+                    local[worker].push_back((int)v);
+                else
+                    mark[v].store(ASSIGNED, memory_order_relaxed);
+            } });
+        gather(remaining);
+
+        while (!remaining.empty())
+        {
+            if (remaining.size() < SERIAL)
+            {
+                serialFinish(remaining);
+                return;
+            }
+            size_t before = remaining.size();
+
+            pool.parallelFor(remaining.size(), GRAIN, [&](size_t begin, size_t end, int)
+                             {
+                for (size_t i = begin; i < end; i++)
+                {
+                    mark[remaining[i]].store(remaining[i], memory_order_relaxed);
+                    queued[remaining[i]].store(1, memory_order_relaxed);
+                } });
+
+            // Push colors forward until nothing changes. Deep graphs need as many
+            // levels as their diameter, so give up on coloring past a work budget.
+            frontier = remaining;
+            size_t work = 0;
+            while (!frontier.empty())
+            {
+                work += frontier.size();
+                if (work > 16 * before)
+                {
+                    serialFinish(remaining);
+                    return;
+                }
+                pool.parallelFor(frontier.size(), FRONTIER, [&](size_t begin, size_t end, int worker)
+                                 {
+                    vector<int> &next = local[worker];
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        int v = frontier[i];
+                        queued[v].store(0);
+                        int color = mark[v].load();
+                        for (int e = fwd.offsets[v]; e < fwd.offsets[v + 1]; e++)
+                        {
+                            int w = fwd.targets[e];
+                            if (raise(w, color) && !queued[w].exchange(1))
+                                next.push_back(w);
+                        }
+                    } });
+                gather(frontier);
+            }
+
+            pool.parallelFor(remaining.size(), GRAIN, [&](size_t begin, size_t end, int worker)
+                             {
+                for (size_t i = begin; i < end; i++)
+                    if (mark[remaining[i]].load(memory_order_relaxed) == remaining[i])
+                        local[worker].push_back(remaining[i]); });
+            gather(roots);
+
+            // Color classes are disjoint, so each root's backward search runs on one worker
+            vector<vector<int>> queues(pool.size());
+            pool.parallelFor(roots.size(), 1, [&](size_t begin, size_t end, int worker)
+                             {
+                vector<int> &queue = queues[worker];
+                for (size_t i = begin; i < end; i++)
+                {
+                    int root = roots[i];
+                    int id = nextComp++;
+                    queue.assign(1, root);
+                    mark[root].store(ASSIGNED, memory_order_relaxed);
+                    for (size_t head = 0; head < queue.size(); head++)
+                    {
+                        int v = queue[head];
+                        comp[v] = id;
+                        for (int e = bwd.offsets[v]; e < bwd.offsets[v + 1]; e++)
+                        {
+                            int w = bwd.targets[e];
+                            if (mark[w].load(memory_order_relaxed) == root)
+                            {
+                                mark[w].store(ASSIGNED, memory_order_relaxed);
+                                queue.push_back(w);
+                            }
+                        }
+                    }
+                } });
+
+            pool.parallelFor(remaining.size(), GRAIN, [&](size_t begin, size_t end, int worker)
+                             {
+                for (size_t i = begin; i < end; i++)
+                    if (comp[remaining[i]] == -1)
+                        local[worker].push_back(remaining[i]); });
+            gather(remaining);
+
+            // Long paths peel one vertex per round; hand those to the serial pass
+            if (remaining.size() > before - before / 100)
+            {
+                serialFinish(remaining);
+                return;
+            }
+        }
+    }
+
+    // Iterative Tarjan over the still unassigned vertices. mark holds the DFS
+    // index (0 = unvisited), queued flags vertices on the Tarjan stack.
+    void ParallelSCC::serialFinish(const vector<int> &remaining)
+    {
+        vector<int> low(V), S;
+        vector<pair<int, int>> frames; // (vertex, next edge position)
+        int index = 1;
+
+        for (int v : remaining)
+            mark[v].store(0, memory_order_relaxed);
+
+        for (int s : remaining)
+        {
+            if (mark[s].load(memory_order_relaxed) != 0)
+                continue;
+
+            mark[s].store(index, memory_order_relaxed);
+            low[s] = index++;
+            S.push_back(s);
+            queued[s].store(1, memory_order_relaxed);
+            frames.push_back({s, fwd.offsets[s]});
+
+            while (!frames.empty())
+            {
+                pair<int, int> &top = frames.back();
+                int v = top.first;
+                if (top.second < fwd.offsets[v + 1])
+                {
+                    int w = fwd.targets[top.second++];
+                    int wIndex = mark[w].load(memory_order_relaxed);
+                    if (wIndex == 0)
+                    {
+                        mark[w].store(index, memory_order_relaxed);
+                        low[w] = index++;
+                        S.push_back(w);
+                        queued[w].store(1, memory_order_relaxed);
+                        frames.push_back({w, fwd.offsets[w]});
+                    }
+                    else if (wIndex != ASSIGNED && queued[w].load(memory_order_relaxed))
+                    {
+                        low[v] = min(low[v], wIndex);
+                    }
+                    continue;
+                }
+
+                frames.pop_back();
+                if (low[v] == mark[v].load(memory_order_relaxed))
+                {
+                    int id = nextComp++;
+                    int w;
+                    do
+                    {
+                        w = S.back();
+                        S.pop_back();
+                        queued[w].store(0, memory_order_relaxed);
+                        comp[w] = id;
+                    } while (w != v);
+                }
+                if (!frames.empty())
+                {
+                    int u = frames.back().first;
+                    low[u] = min(low[u], low[v]);
+                }
+            }
+        }
+    }
+}
+
+int parallelSCC(const CSRView &fwd, const CSRView &bwd, vector<int> &comp, int count, WorkerPool &pool)
+{
+    ParallelSCC scc(fwd, bwd, comp, count, pool);
+    scc.forwardBackward();
+    scc.coloring();
+    return scc.count();
+}
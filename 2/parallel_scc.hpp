@@ -0,0 +1,58 @@
+#ifndef PARALLEL_SCC_HPP
+#define PARALLEL_SCC_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+using namespace std;
+
+// Fixed set of worker threads that split index ranges between them.
+// The calling thread takes part as worker 0, so a pool of size 1 runs inline.
+class WorkerPool
+{
+public:
+    explicit WorkerPool(int threads = 0); // 0 picks hardware_concurrency()
+    ~WorkerPool();
+
+    int size() const { return (int)workers.size() + 1; }
+
+    // Run body(begin, end, worker) over [0, n) in chunks of about grain indices
+    void parallelFor(size_t n, size_t grain, const function<void(size_t, size_t, int)> &body);
+
+private:
+    void workerLoop(int id);
+    void runChunks(int id);
+
+    vector<thread> workers;
+    mutex runMutex; // Serializes parallelFor calls from different threads
+    mutex m;
+    condition_variable startCv, doneCv;
+    const function<void(size_t, size_t, int)> *job = nullptr;
+    size_t jobSize = 0, jobGrain = 1;
+    atomic<size_t> nextIndex{0};
+    int busy = 0;
+    unsigned long generation = 0;
+    bool stopping = false;
+};
+
+// Read-only CSR view: the out-edges of v are targets[offsets[v]] .. targets[offsets[v + 1] - 1]
+struct CSRView
+{
+    int V;
+    const int *offsets;
+    const int *targets;
+};
+
+// Parallel SCC: one forward-backward sweep from a high degree pivot to peel the
+// giant component, then rounds of max-label coloring for everything else.
+// fwd and bwd are the graph and its transpose. comp must hold -1 for every
+// vertex still to be assigned; other entries (e.g. from a trim pass) are kept,
+// and count says how many ids they already use. New ids follow on, carry no
+// topological order, and the new total is returned.
+int parallelSCC(const CSRView &fwd, const CSRView &bwd, vector<int> &comp, int count, WorkerPool &pool);
+
+#endif // PARALLEL_SCC_HPP
@@ -16,7 +16,7 @@ fi
 
 # Compile all versions with profiling enabled
 make clean
-make CFLAGS="-std=c++17 -Wall -Wextra -pg"
+make CFLAGS="-std=c++17 -Wall -Wextra -pg -pthread"
 
 # Function to generate random graph data
 generate_random_data() 
@@ -39,6 +39,13 @@ if [ ! -f "$DATA_FILE" ]; then
     generate_random_data $VERTICES $EDGES > "$DATA_FILE"
 fi
 
+# Convert it once to the binary CSR format, which kosaraju_csr maps directly.
+# The random pairs repeat, so the parallel edges are dropped on the way.
+BINARY_FILE="random_data.bin"
+if [ ! -f "$BINARY_FILE" ] || [ "$DATA_FILE" -nt "$BINARY_FILE" ]; then
+    ./csr_convert -t -d "$BINARY_FILE" < "$DATA_FILE"
+fi
+
 # Function to profile and generate graph
 profile_and_generate_graph() 
 {
@@ -46,9 +53,10 @@ profile_and_generate_graph()
     local profile_file=$2
     local dot_file=$3
     local png_file=$4
+    local input=${5:-$DATA_FILE}
 
     echo "Profiling $target..."
-    ./$target < "$DATA_FILE"
+    ./$target < "$input"
 
     if [ $? -eq 0 ]; then
         gprof $target gmon.out > $profile_file
@@ -68,5 +76,6 @@ profile_and_generate_graph "kosaraju_deque" "kosaraju_deque_profile.txt" "kosara
 profile_and_generate_graph "kosaraju_deque_matrix" "kosaraju_deque_matrix_profile.txt" "kosaraju_deque_matrix_profile.dot" "kosaraju_deque_matrix_profile.png"
 profile_and_generate_graph "kosaraju_list" "kosaraju_list_profile.txt" "kosaraju_list_profile.dot" "kosaraju_list_profile.png"
 profile_and_generate_graph "kosaraju_list_matrix" "kosaraju_list_matrix_profile.txt" "kosaraju_list_matrix_profile.dot" "kosaraju_list_matrix_profile.png"
+profile_and_generate_graph "kosaraju_csr" "kosaraju_csr_profile.txt" "kosaraju_csr_profile.dot" "kosaraju_csr_profile.png" "$BINARY_FILE"
 
 echo "Profiling and graph generation complete. Check the profile files and graphs for details."
@@ -0,0 +1,91 @@
+#ifndef SCC_OUTPUT_HPP
+#define SCC_OUTPUT_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <charconv>
+
+using namespace std;
+
+// How a set of SCCs is written out
+enum class OutputFormat
+{
+    Text,  // One line per component, 1-based vertices separated by spaces
+    Ids,   // Binary: "SCCI", V, count, then the int32 component id of every vertex
+    Deltas // Binary: "SCCD", V, count, then per component its size, first member and
+           // the gaps to the following members, all as LEB128 varints, 0-based
+};
+
+// Parse an output format name; an empty name selects Text
+bool parseFormat(const string &name, OutputFormat &format);
+
+// Append-only byte buffer made of fixed size chunks. clear() keeps the chunks,
+// so a buffer reused across results stops allocating once it has grown, and
+// writeTo hands every chunk to the kernel in one writev.
+class OutputBuffer
+{
+public:
+    static const size_t CHUNK = 1 << 16;
+
+    OutputBuffer() { clear(); }
+
+    void clear();
+    size_t size() const;
+
+    void put(char c)
+    {
+        room(1);
+        *cursor++ = c;
+    }
+
+    void putInt(int value)
+    {
+        room(12);
+        cursor = to_chars(cursor, limit, value).ptr;
+    }
+
+    // Unsigned LEB128: 7 bits per byte, high bit set on all but the last
+    void putVarint(uint32_t value)
+    {
+        room(5);
+        while (value >= 0x80)
+        {
+            *cursor++ = (char)(value | 0x80);
+            value >>= 7;
+        }
+        *cursor++ = (char)value;
+    }
+
+    void append(const void *data, size_t n);
+    void append(const string &text) { append(text.data(), text.size()); }
+
+    // Write everything to fd (a file or a socket), retrying partial writes
+    bool writeTo(int fd) const;
+    string str() const;
+
+private:
+    struct Chunk
+    {
+        unique_ptr<char[]> data;
+        size_t used;
+    };
+
+    vector<Chunk> chunks;
+    size_t current = 0; // Chunk being filled; its used count lives in cursor
+    char *cursor = nullptr, *limit = nullptr;
+
+    void room(size_t n)
+    {
+        if ((size_t)(limit - cursor) < n)
+            nextChunk();
+    }
+    void nextChunk();
+    size_t used(size_t i) const { return i == current ? cursor - chunks[i].data.get() : chunks[i].used; }
+};
+
+// Write a complete assignment (every vertex has an id in [0, count)) in a binary format
+void writeComponents(OutputBuffer &out, OutputFormat format, const vector<int> &comp, int count);
+
+#endif // SCC_OUTPUT_HPP
@@ -12,8 +12,8 @@ class Graph
     int V;                   // Number of vertices
     vector<vector<int>> adj; // Adjacency list
 
-    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque);
-    void DFSUtil(int v, vector<bool> &visited);
+    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames);
+    void DFSUtil(int v, vector<bool> &visited, vector<pair<int, int>> &frames);
 
 public:
     Graph(int V);
@@ -39,13 +39,29 @@ void Graph::removeEdge(int v, int w)
     adj[v].erase(remove(adj[v].begin(), adj[v].end(), w), adj[v].end());
 }
 
-void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque)
+void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames)
 {
     visited[v] = true;
-    for (int i : adj[v])
-        if (!visited[i])
-            fillOrder(i, visited, Deque);
-    Deque.push_back(v);
+    frames.push_back({v, 0});
+
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)adj[top.first].size())
+        {
+            int i = adj[top.first][top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                frames.push_back({i, 0});
+            }
+        }
+        else
+        {
+            Deque.push_back(top.first);
+            frames.pop_back();
+        }
+    }
 }
 
 Graph Graph::getTranspose()
@@ -59,22 +75,38 @@ Graph Graph::getTranspose()
     return g;
 }
 
-void Graph::DFSUtil(int v, vector<bool> &visited)
+void Graph::DFSUtil(int v, vector<bool> &visited, vector<pair<int, int>> &frames)
 {
     visited[v] = true;
     cout << v + 1 << " ";
-    for (int i : adj[v])
-        if (!visited[i])
-            DFSUtil(i, visited);
+    frames.push_back({v, 0});
+
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)adj[top.first].size())
+        {
+            int i = adj[top.first][top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                cout << i + 1 << " ";
+                frames.push_back({i, 0});
+            }
+        }
+        else
+            frames.pop_back();
+    }
 }
 
 void Graph::printSCCs()
 {
     deque<int> Deque;
+    vector<pair<int, int>> frames; // DFS frames, reused by every traversal below
     vector<bool> visited(V, false);
     for (int i = 0; i < V; i++)
         if (!visited[i])
-            fillOrder(i, visited, Deque);
+            fillOrder(i, visited, Deque, frames);
 
     Graph gr = getTranspose();
     fill(visited.begin(), visited.end(), false);
@@ -85,7 +117,7 @@ void Graph::printSCCs()
         Deque.pop_back();
         if (!visited[v])
         {
-            gr.DFSUtil(v, visited);
+            gr.DFSUtil(v, visited, frames);
             cout << endl;
         }
     }
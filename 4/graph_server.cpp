@@ -4,6 +4,11 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <climits>
+#include <cctype>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <pthread.h>
@@ -13,87 +18,228 @@ using namespace std;
 // Graph class to represent a directed graph using adjacency list representation
 class Graph
 {
-    int V;                   // Number of vertices
-    vector<vector<int>> adj; // Adjacency list
+    int V;                    // Number of vertices
+    vector<vector<int>> adj;  // Adjacency list
+    vector<vector<int>> radj; // Reverse adjacency list, kept in step with adj
+    vector<vector<int>> adjPos;  // adjPos[v][i]: index of the edge v -> adj[v][i] in radj[adj[v][i]]
+    vector<vector<int>> radjPos; // radjPos[w][j]: index of the edge radj[w][j] -> w in adj[radj[w][j]]
+
+    // Hash index over the out-edges of vertices with more than HUB_DEGREE of them:
+    // target -> slots in adj. Smaller lists are cheaper to scan.
+    static const size_t HUB_DEGREE = 32;
+    unordered_map<int, unordered_multimap<int, int>> hubIndex;
+    bool dedup; // Keep a single copy of every edge: addEdge ignores one already present
+
+    unsigned long version = 0;       // Bumped by every mutation
+    unsigned long cachedVersion = 0; // Version the cached result was computed for
+    shared_ptr<const string> cached; // Last printSCCs result, shared with senders
 
     // Function to fill the order of vertices
-    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque);
+    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames);
     // Function to perform DFS traversal
-    void DFSUtil(int v, vector<bool> &visited, stringstream &out);
+    void DFSUtil(const vector<vector<int>> &lists, int v, vector<bool> &visited, stringstream &out, vector<pair<int, int>> &frames);
+    // Remove one edge and its reverse twin by swapping in the last entries
+    void unlinkEdge(int v, int i);
+    // Build the hash index of a high out-degree vertex
+    void indexHub(int v);
+    // Check for an edge without scanning a hub's list
+    bool hasEdge(int v, int w);
 
 public:
-    Graph(int V);                  // Constructor
-    void addEdge(int v, int w);    // Add an edge to the graph
-    void removeEdge(int v, int w); // Remove an edge from the graph
-    string printSCCs();            // Print Strongly Connected Components
-    Graph getTranspose();          // Get the transpose of the graph
+    Graph(int V, bool dedup = false);     // Constructor
+    void addEdge(int v, int w);           // Add an edge to the graph
+    void removeEdge(int v, int w);        // Remove an edge from the graph
+    shared_ptr<const string> printSCCs(); // Print Strongly Connected Components
+    int vertices() const { return V; }    // Number of vertices
 };
 
 // Constructor
-Graph::Graph(int V)
+Graph::Graph(int V, bool dedup)
 {
     this->V = V;
+    this->dedup = dedup;
     adj.resize(V);
+    radj.resize(V);
+    adjPos.resize(V);
+    radjPos.resize(V);
 }
 
 // Add an edge to the graph
 void Graph::addEdge(int v, int w)
 {
+    if (dedup && hasEdge(v, w))
+        return;
+
+    // Each edge records where its twin sits in the other list, so removal never searches radj
+    adjPos[v].push_back((int)radj[w].size());
+    radjPos[w].push_back((int)adj[v].size());
     adj[v].push_back(w);
+    radj[w].push_back(v);
+
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+        hub->second.emplace(w, (int)adj[v].size() - 1);
+    else if (adj[v].size() > HUB_DEGREE)
+        indexHub(v);
+    version++;
 }
 
 // Remove an edge from the graph
 void Graph::removeEdge(int v, int w)
 {
-    adj[v].erase(remove(adj[v].begin(), adj[v].end(), w), adj[v].end());
+    // Slots in adj[v] holding a copy of the edge: a hash lookup for hubs, a short scan otherwise
+    vector<int> slots;
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+    {
+        auto range = hub->second.equal_range(w);
+        for (auto it = range.first; it != range.second; ++it)
+            slots.push_back(it->second);
+        hub->second.erase(range.first, range.second);
+    }
+    else
+    {
+        for (int i = 0; i < (int)adj[v].size(); i++)
+            if (adj[v][i] == w)
+                slots.push_back(i);
+    }
+
+    // Highest slot first, so the edge moved into a freed slot is never another copy
+    sort(slots.begin(), slots.end(), greater<int>());
+    for (int i : slots)
+        unlinkEdge(v, i);
+    if (hub != hubIndex.end() && adj[v].size() < HUB_DEGREE / 2)
+        hubIndex.erase(hub);
+    version++;
 }
 
-// Fill the order of vertices for SCC
-void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque)
+// Remove the edge in slot i of adj[v] and its twin in radj, each by moving the
+// last entry of its list into the hole. O(1) apart from a hub's multiplicity.
+void Graph::unlinkEdge(int v, int i)
 {
-    visited[v] = true;
-    for (int i : adj[v])
-        if (!visited[i])
-            fillOrder(i, visited, Deque);
-    Deque.push_back(v);
+    int w = adj[v][i], j = adjPos[v][i];
+
+    int last = (int)radj[w].size() - 1;
+    if (j != last)
+    {
+        int u = radj[w][last], k = radjPos[w][last];
+        radj[w][j] = u;
+        radjPos[w][j] = k;
+        adjPos[u][k] = j;
+    }
+    radj[w].pop_back();
+    radjPos[w].pop_back();
+
+    last = (int)adj[v].size() - 1;
+    if (i != last)
+    {
+        int x = adj[v][last], k = adjPos[v][last];
+        adj[v][i] = x;
+        adjPos[v][i] = k;
+        radjPos[x][k] = i;
+
+        auto hub = hubIndex.find(v);
+        if (hub != hubIndex.end())
+        {
+            auto range = hub->second.equal_range(x);
+            for (auto it = range.first; it != range.second; ++it)
+                if (it->second == last)
+                {
+                    it->second = i;
+                    break;
+                }
+        }
+    }
+    adj[v].pop_back();
+    adjPos[v].pop_back();
+}
+
+// Start indexing the out-edges of v, which just outgrew a linear scan
+void Graph::indexHub(int v)
+{
+    unordered_multimap<int, int> &index = hubIndex[v];
+    index.reserve(adj[v].size() * 2);
+    for (int i = 0; i < (int)adj[v].size(); i++)
+        index.emplace(adj[v][i], i);
+}
+
+// Whether v -> w is present, through the hub index or a scan of a short list
+bool Graph::hasEdge(int v, int w)
+{
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+        return hub->second.count(w) > 0;
+    return find(adj[v].begin(), adj[v].end(), w) != adj[v].end();
 }
 
-// Get the transpose of the graph
-Graph Graph::getTranspose()
+// Fill the order of vertices for SCC (iterative DFS, no recursion)
+void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames)
 {
-    Graph g(V);
-    for (int v = 0; v < V; v++)
+    visited[v] = true;
+    frames.push_back({v, 0});
+
+    while (!frames.empty())
     {
-        for (int i : adj[v])
-            g.adj[i].push_back(v);
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)adj[top.first].size())
+        {
+            int i = adj[top.first][top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                frames.push_back({i, 0});
+            }
+        }
+        else
+        {
+            Deque.push_back(top.first);
+            frames.pop_back();
+        }
     }
-    return g;
 }
 
-// DFS traversal
-void Graph::DFSUtil(int v, vector<bool> &visited, stringstream &out)
+// DFS traversal over lists (adj or radj) using the caller's frame buffer
+void Graph::DFSUtil(const vector<vector<int>> &lists, int v, vector<bool> &visited, stringstream &out, vector<pair<int, int>> &frames)
 {
     visited[v] = true;
     out << v + 1 << " ";
-    for (int i : adj[v])
-        if (!visited[i])
-            DFSUtil(i, visited, out);
+    frames.push_back({v, 0});
+
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)lists[top.first].size())
+        {
+            int i = lists[top.first][top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                out << i + 1 << " ";
+                frames.push_back({i, 0});
+            }
+        }
+        else
+            frames.pop_back();
+    }
 }
 
 // Print Strongly Connected Components
-string Graph::printSCCs()
+shared_ptr<const string> Graph::printSCCs()
 {
+    // Nothing changed since the last call: hand out the same bytes again.
+    // Filling the cache writes to the graph, so callers hold graphMutex.
+    if (cached && cachedVersion == version)
+        return cached;
+
     deque<int> Deque;
+    vector<pair<int, int>> frames; // DFS frames, reused by every traversal below
     vector<bool> visited(V, false);
     stringstream result;
 
     // Fill vertices in stack according to their finishing times
     for (int i = 0; i < V; i++)
         if (!visited[i])
-            fillOrder(i, visited, Deque);
-
-    // Create a reversed graph
-    Graph gr = getTranspose();
+            fillOrder(i, visited, Deque, frames);
 
     // Mark all the vertices as not visited (For second DFS)
     fill(visited.begin(), visited.end(), false);
@@ -105,72 +251,198 @@ string Graph::printSCCs()
         Deque.pop_back();
         if (!visited[v])
         {
-            gr.DFSUtil(v, visited, result);
+            DFSUtil(radj, v, visited, result, frames);
             result << endl;
         }
     }
 
-    return result.str();
+    cached = make_shared<const string>(result.str());
+    cachedVersion = version;
+    return cached;
 }
 
 // Global pointer to the graph object
 Graph *g = nullptr;
 
+// Set by -d: every graph keeps a single copy of each edge
+bool dedupEdges = false;
+
+// POSIX mutex to protect the shared graph object, including its cached result
+pthread_mutex_t graphMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Input side of one client connection. What recv returns stays buffered across
+// commands, so a command split over several reads, several commands in one
+// read and payloads of any length all parse the same way.
+class ClientReader
+{
+public:
+    explicit ClientReader(int fd) : fd(fd) {}
+
+    static const size_t MAX_LINE = 1 << 16; // Longer lines and tokens are refused
+
+    // Next line without its newline; false once the client is gone. A line
+    // longer than MAX_LINE is dropped as it arrives and reported as tooLong.
+    bool readLine(string &line, bool &tooLong)
+    {
+        tooLong = false;
+        size_t newline, scanned = 0; // scanned: bytes after pos known to hold no newline
+        while ((newline = in.find('\n', pos + scanned)) == string::npos)
+        {
+            if (in.size() - pos > MAX_LINE)
+            {
+                tooLong = true;
+                pos = in.size();
+            }
+            scanned = in.size() - pos;
+            if (!fill())
+                return false;
+        }
+        if (tooLong)
+            line.clear();
+        else
+            line.assign(in, pos, newline - pos);
+        pos = newline + 1;
+        return true;
+    }
+
+    // Next whitespace-separated token: first from rest, what followed the
+    // command on its line, then from further input. A token at the very end of
+    // the input may still be cut off, so it counts once whitespace follows it.
+    // False once the client is gone or for a token longer than MAX_LINE.
+    bool readToken(istringstream &rest, string &token)
+    {
+        if (rest >> token)
+            return true;
+        while (true)
+        {
+            while (pos < in.size() && isspace((unsigned char)in[pos]))
+                pos++;
+            size_t end = pos;
+            while (end < in.size() && !isspace((unsigned char)in[end]))
+                end++;
+            if (end < in.size())
+            {
+                token.assign(in, pos, end - pos);
+                pos = end;
+                return true;
+            }
+            if (end - pos > MAX_LINE || !fill())
+                return false;
+        }
+    }
+
+private:
+    int fd;
+    string in; // in[pos..] is received but not parsed yet
+    size_t pos = 0;
+
+    bool fill()
+    {
+        in.erase(0, pos);
+        pos = 0;
+        char chunk[1 << 16];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 1)
+            return false;
+        in.append(chunk, n);
+        return true;
+    }
+};
+
+// A 1-based vertex number as a 0-based index; false if token isn't one
+bool parseVertex(const string &token, int &vertex)
+{
+    char *end;
+    long value = strtol(token.c_str(), &end, 10);
+    if (token.empty() || *end || value < 1 || value > INT_MAX)
+        return false;
+    vertex = (int)value - 1;
+    return true;
+}
+
 // Function to handle client requests
 void *handleClient(void *arg)
 {
     int clientSocket = *(int *)arg;
     delete (int *)arg;
 
-    char buffer[1024];
+    ClientReader reader(clientSocket);
     string line;
 
     // Send instructions to the client
     string instructions = "Please insert one of the following commands:\n"
-                          "Newgraph <n> <m> - Create a new graph with n vertices and m edges\n"
+                          "Newgraph <n> <m> - Create a new graph with n vertices and m edges, followed by m pairs \"i j\"\n"
                           "Kosaraju - Print SCCs of the graph\n"
                           "Newedge <i> <j> - Add edge from vertex i to vertex j\n"
                           "Removeedge <i> <j> - Remove edge from vertex i to vertex j\n";
     send(clientSocket, instructions.c_str(), instructions.size(), 0);
 
-    while (true)
+    // One command per line; a pipelining client gets the replies in order
+    bool tooLong;
+    while (reader.readLine(line, tooLong))
     {
-        // Receive command from client
-        ssize_t bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-        if (bytesReceived < 1)
+        if (tooLong)
         {
-            close(clientSocket);
-            return nullptr;
+            send(clientSocket, "Invalid command\n", 16, 0);
+            continue;
         }
-        buffer[bytesReceived] = '\0';
-        line = buffer;
 
         istringstream iss(line);
         string command;
-        iss >> command;
+        if (!(iss >> command))
+            continue; // Blank line
 
         if (command == "Newgraph")
         {
-            int n, m;
+            int n = 0, m = -1;
             iss >> n >> m;
-            delete g;
-            g = new Graph(n);
-            for (int i = 0; i < m; ++i)
+            if (n < 1 || m < 0)
+            {
+                send(clientSocket, "Invalid graph\n", 14, 0);
+                continue;
+            }
+
+            // The edges may follow on this line or on any number of later ones.
+            // The graph is built privately while they arrive.
+            Graph *created = new Graph(n, dedupEdges);
+            bool valid = true;
+            string token;
+            int i = 0;
+            for (; i < m; ++i)
             {
                 int src, dest;
-                recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-                istringstream edgeStream(buffer);
-                edgeStream >> src >> dest;
-                g->addEdge(src - 1, dest - 1);
+                if (!reader.readToken(iss, token) || !parseVertex(token, src) ||
+                    !reader.readToken(iss, token) || !parseVertex(token, dest))
+                    break;
+                // A vertex outside the new graph spoils it, but the edges are still read to the end
+                valid = valid && src < n && dest < n;
+                if (valid)
+                    created->addEdge(src, dest);
+            }
+            if (i < m || !valid)
+            {
+                delete created;
+                send(clientSocket, "Invalid graph\n", 14, 0);
+                continue;
             }
+            pthread_mutex_lock(&graphMutex);
+            swap(g, created);
+            pthread_mutex_unlock(&graphMutex);
+            delete created; // The old graph
             send(clientSocket, "Created new graph\n", 18, 0);
         }
         else if (command == "Kosaraju")
         {
+            // The result is shared, so it can be sent after the lock is released
+            shared_ptr<const string> result;
+            pthread_mutex_lock(&graphMutex);
             if (g)
+                result = g->printSCCs();
+            pthread_mutex_unlock(&graphMutex);
+
+            if (result)
             {
-                string result = g->printSCCs();
-                send(clientSocket, result.c_str(), result.size(), 0);
+                send(clientSocket, result->c_str(), result->size(), 0);
             }
             else
             {
@@ -179,31 +451,45 @@ void *handleClient(void *arg)
         }
         else if (command == "Newedge")
         {
-            int i, j;
-            iss >> i >> j;
-            if (g)
+            string first, second;
+            int i = 0, j = 0;
+            bool valid = iss >> first >> second && parseVertex(first, i) && parseVertex(second, j);
+            pthread_mutex_lock(&graphMutex);
+            if (!g)
             {
-                g->addEdge(i - 1, j - 1);
-                send(clientSocket, "Edge added\n", 11, 0);
+                send(clientSocket, "No graph created yet.\n", 22, 0);
+            }
+            else if (!valid || i >= g->vertices() || j >= g->vertices())
+            {
+                send(clientSocket, "Invalid vertex\n", 15, 0);
             }
             else
             {
-                send(clientSocket, "No graph created yet.\n", 22, 0);
+                g->addEdge(i, j);
+                send(clientSocket, "Edge added\n", 11, 0);
             }
+            pthread_mutex_unlock(&graphMutex);
         }
         else if (command == "Removeedge")
         {
-            int i, j;
-            iss >> i >> j;
-            if (g)
+            string first, second;
+            int i = 0, j = 0;
+            bool valid = iss >> first >> second && parseVertex(first, i) && parseVertex(second, j);
+            pthread_mutex_lock(&graphMutex);
+            if (!g)
             {
-                g->removeEdge(i - 1, j - 1);
-                send(clientSocket, "Edge removed\n", 13, 0);
+                send(clientSocket, "No graph created yet.\n", 22, 0);
+            }
+            else if (!valid || i >= g->vertices() || j >= g->vertices())
+            {
+                send(clientSocket, "Invalid vertex\n", 15, 0);
             }
             else
             {
-                send(clientSocket, "No graph created yet.\n", 22, 0);
+                g->removeEdge(i, j);
+                send(clientSocket, "Edge removed\n", 13, 0);
             }
+            pthread_mutex_unlock(&graphMutex);
         }
         else
         {
@@ -215,8 +501,11 @@ void *handleClient(void *arg)
     return nullptr;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+    // -d: drop parallel edges as they arrive instead of storing every copy
+    dedupEdges = argc > 1 && string(argv[1]) == "-d";
+
     int serverSocket, clientSocket;
     sockaddr_in serverAddr, clientAddr;
     socklen_t clientAddrSize;
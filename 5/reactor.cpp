@@ -1,13 +1,21 @@
 #include "reactor.hpp"
 #include <iostream>
 #include <unistd.h>
-#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 
-Reactor::Reactor() {}
+Reactor::Reactor(bool edgeTriggered) : edgeTriggered(edgeTriggered), events(64)
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0)
+        perror("epoll_create1");
+}
 
 Reactor::~Reactor()
 {
     stopReactor(this);
+    if (epollFd >= 0)
+        close(epollFd);
 }
 
 void *Reactor::startReactor()
@@ -18,10 +26,20 @@ void *Reactor::startReactor()
 int Reactor::addFdToReactor(void *reactor_ptr, int fd, reactorFunc func)
 {
     Reactor *reactor = static_cast<Reactor *>(reactor_ptr);
-    struct pollfd pfd;
-    pfd.fd = fd;
-    pfd.events = POLLIN;
-    reactor->pollfds.push_back(pfd);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | (reactor->edgeTriggered ? EPOLLET : 0);
+    ev.data.fd = fd;
+
+    // Registering an fd again just replaces its callback
+    if (epoll_ctl(reactor->epollFd, EPOLL_CTL_ADD, fd, &ev) < 0 &&
+        (errno != EEXIST || epoll_ctl(reactor->epollFd, EPOLL_CTL_MOD, fd, &ev) < 0))
+    {
+        perror("epoll_ctl");
+        return -1;
+    }
+
+    if (fd >= (int)reactor->callbacks.size())
+        reactor->callbacks.resize(fd + 1);
     reactor->callbacks[fd] = func;
     return 0;
 }
@@ -29,11 +47,11 @@ int Reactor::addFdToReactor(void *reactor_ptr, int fd, reactorFunc func)
 int Reactor::removeFdFromReactor(void *reactor_ptr, int fd)
 {
     Reactor *reactor = static_cast<Reactor *>(reactor_ptr);
-    reactor->pollfds.erase(std::remove_if(reactor->pollfds.begin(), reactor->pollfds.end(),
-                                          [fd](const struct pollfd &pfd)
-                                          { return pfd.fd == fd; }),
-                           reactor->pollfds.end());
-    reactor->callbacks.erase(fd);
+    // A closed fd has already left the epoll set on its own
+    if (epoll_ctl(reactor->epollFd, EPOLL_CTL_DEL, fd, nullptr) < 0 && errno != EBADF && errno != ENOENT)
+        perror("epoll_ctl");
+    if (fd < (int)reactor->callbacks.size())
+        reactor->callbacks[fd] = nullptr;
     return 0;
 }
 
@@ -48,22 +66,28 @@ void Reactor::run()
 {
     while (running)
     {
-        int ready = poll(pollfds.data(), pollfds.size(), 100);
+        int ready = epoll_wait(epollFd, events.data(), (int)events.size(), 100);
         if (ready < 0)
         {
-            perror("poll");
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
             break;
         }
 
-        for (const auto &pfd : pollfds)
+        // Hangups and errors are dispatched too, so the callback sees the failed read
+        for (int i = 0; i < ready; i++)
         {
-            if (pfd.revents & POLLIN)
+            int fd = events[i].data.fd;
+            if (fd < (int)callbacks.size() && callbacks[fd])
             {
-                if (callbacks.find(pfd.fd) != callbacks.end())
-                {
-                    callbacks[pfd.fd](pfd.fd);
-                }
+                // A copy, since the callback may register fds and grow the table
+                reactorFunc func = callbacks[fd];
+                func(fd);
             }
         }
+
+        if (ready == (int)events.size())
+            events.resize(events.size() * 2);
     }
 }
@@ -1,25 +1,30 @@
 #ifndef REACTOR_HPP
 #define REACTOR_HPP
 
-#include <unordered_map>
 #include <vector>
 #include <functional>
-#include <poll.h>
+#include <sys/epoll.h>
 
 using namespace std;
 
 using reactorFunc = function<void(int)>;
 
+// Event loop over epoll: registering and removing an fd are single epoll_ctl
+// calls, and each wakeup only visits the fds that are ready.
 class Reactor
 {
 private:
-    unordered_map<int, reactorFunc> callbacks;
-    vector<struct pollfd> pollfds;
+    int epollFd;
+    bool edgeTriggered;                // EPOLLET; callbacks must then read their fd until EAGAIN
+    vector<reactorFunc> callbacks;     // Indexed by fd
+    vector<struct epoll_event> events;
     bool running = false;
 
 public:
-    Reactor();
+    Reactor(bool edgeTriggered = false);
     ~Reactor();
+    Reactor(const Reactor &) = delete;
+    Reactor &operator=(const Reactor &) = delete;
 
     void *startReactor();
     int addFdToReactor(void *reactor, int fd, reactorFunc func);
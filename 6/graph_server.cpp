@@ -9,6 +9,14 @@
 #include <vector>
 #include <deque>
 #include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <pthread.h>
+#include <cstdlib>
+#include <climits>
 
 const int PORT = 9034;
 using namespace std;
@@ -16,89 +24,232 @@ using namespace std;
 // Graph class to represent a directed graph using adjacency list representation
 class Graph
 {
-    int V;                   // Number of vertices
-    vector<vector<int>> adj; // Adjacency list
+    int V;                    // Number of vertices
+    vector<vector<int>> adj;  // Adjacency list
+    vector<vector<int>> radj; // Reverse adjacency list, kept in step with adj
+    vector<vector<int>> adjPos;  // adjPos[v][i]: index of the edge v -> adj[v][i] in radj[adj[v][i]]
+    vector<vector<int>> radjPos; // radjPos[w][j]: index of the edge radj[w][j] -> w in adj[radj[w][j]]
+
+    // Hash index over the out-edges of vertices with more than HUB_DEGREE of them:
+    // target -> slots in adj. Smaller lists are cheaper to scan.
+    static const size_t HUB_DEGREE = 32;
+    unordered_map<int, unordered_multimap<int, int>> hubIndex;
+    bool dedup; // Keep a single copy of every edge: addEdge ignores one already present
+
+    unsigned long version = 0;       // Bumped by every mutation
+    unsigned long cachedVersion = 0; // Version the cached result was computed for
+    shared_ptr<const string> cached; // Last printSCCs result, shared with senders
 
     // Function to fill the order of vertices
-    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque);
+    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames);
     // Function to perform DFS traversal
-    void DFSUtil(int v, vector<bool> &visited, stringstream &out);
+    void DFSUtil(const vector<vector<int>> &lists, int v, vector<bool> &visited, stringstream &out, vector<pair<int, int>> &frames);
+    // Remove one edge and its reverse twin by swapping in the last entries
+    void unlinkEdge(int v, int i);
+    // Build the hash index of a high out-degree vertex
+    void indexHub(int v);
+    // Check for an edge without scanning a hub's list
+    bool hasEdge(int v, int w);
 
 public:
-    Graph(int V);                  // Constructor
-    void addEdge(int v, int w);    // Add an edge to the graph
-    void removeEdge(int v, int w); // Remove an edge from the graph
-    string printSCCs();            // Print Strongly Connected Components
-    Graph getTranspose();          // Get the transpose of the graph
+    Graph(int V, bool dedup = false);     // Constructor
+    void addEdge(int v, int w);           // Add an edge to the graph
+    void removeEdge(int v, int w);        // Remove an edge from the graph
+    shared_ptr<const string> printSCCs(); // Print Strongly Connected Components
 };
 
 // Constructor
-Graph::Graph(int V)
+Graph::Graph(int V, bool dedup)
 {
     this->V = V;
+    this->dedup = dedup;
     adj.resize(V);
+    radj.resize(V);
+    adjPos.resize(V);
+    radjPos.resize(V);
 }
 
 // Add an edge to the graph
 void Graph::addEdge(int v, int w)
 {
+    if (dedup && hasEdge(v, w))
+        return;
+
+    // Each edge records where its twin sits in the other list, so removal never searches radj
+    adjPos[v].push_back((int)radj[w].size());
+    radjPos[w].push_back((int)adj[v].size());
     adj[v].push_back(w);
+    radj[w].push_back(v);
+
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+        hub->second.emplace(w, (int)adj[v].size() - 1);
+    else if (adj[v].size() > HUB_DEGREE)
+        indexHub(v);
+    version++;
 }
 
 // Remove an edge from the graph
 void Graph::removeEdge(int v, int w)
 {
-    adj[v].erase(remove(adj[v].begin(), adj[v].end(), w), adj[v].end());
+    // Slots in adj[v] holding a copy of the edge: a hash lookup for hubs, a short scan otherwise
+    vector<int> slots;
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+    {
+        auto range = hub->second.equal_range(w);
+        for (auto it = range.first; it != range.second; ++it)
+            slots.push_back(it->second);
+        hub->second.erase(range.first, range.second);
+    }
+    else
+    {
+        for (int i = 0; i < (int)adj[v].size(); i++)
+            if (adj[v][i] == w)
+                slots.push_back(i);
+    }
+
+    // Highest slot first, so the edge moved into a freed slot is never another copy
+    sort(slots.begin(), slots.end(), greater<int>());
+    for (int i : slots)
+        unlinkEdge(v, i);
+    if (hub != hubIndex.end() && adj[v].size() < HUB_DEGREE / 2)
+        hubIndex.erase(hub);
+    version++;
 }
 
-// Fill the order of vertices for SCC
-void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque)
+// Remove the edge in slot i of adj[v] and its twin in radj, each by moving the
+// last entry of its list into the hole. O(1) apart from a hub's multiplicity.
+void Graph::unlinkEdge(int v, int i)
 {
-    visited[v] = true;
-    for (int i : adj[v])
-        if (!visited[i])
-            fillOrder(i, visited, Deque);
-    Deque.push_back(v);
+    int w = adj[v][i], j = adjPos[v][i];
+
+    int last = (int)radj[w].size() - 1;
+    if (j != last)
+    {
+        int u = radj[w][last], k = radjPos[w][last];
+        radj[w][j] = u;
+        radjPos[w][j] = k;
+        adjPos[u][k] = j;
+    }
+    radj[w].pop_back();
+    radjPos[w].pop_back();
+
+    last = (int)adj[v].size() - 1;
+    if (i != last)
+    {
+        int x = adj[v][last], k = adjPos[v][last];
+        adj[v][i] = x;
+        adjPos[v][i] = k;
+        radjPos[x][k] = i;
+
+        auto hub = hubIndex.find(v);
+        if (hub != hubIndex.end())
+        {
+            auto range = hub->second.equal_range(x);
+            for (auto it = range.first; it != range.second; ++it)
+                if (it->second == last)
+                {
+                    it->second = i;
+                    break;
+                }
+        }
+    }
+    adj[v].pop_back();
+    adjPos[v].pop_back();
+}
+
+// Start indexing the out-edges of v, which just outgrew a linear scan
+void Graph::indexHub(int v)
+{
+    unordered_multimap<int, int> &index = hubIndex[v];
+    index.reserve(adj[v].size() * 2);
+    for (int i = 0; i < (int)adj[v].size(); i++)
+        index.emplace(adj[v][i], i);
 }
 
-// Get the transpose of the graph
-Graph Graph::getTranspose()
+// Whether v -> w is present, through the hub index or a scan of a short list
+bool Graph::hasEdge(int v, int w)
 {
-    Graph g(V);
-    for (int v = 0; v < V; v++)
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+        return hub->second.count(w) > 0;
+    return find(adj[v].begin(), adj[v].end(), w) != adj[v].end();
+}
+
+// Fill the order of vertices for SCC (iterative DFS, no recursion)
+void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames)
+{
+    visited[v] = true;
+    frames.push_back({v, 0});
+
+    while (!frames.empty())
     {
-        for (int i : adj[v])
-            g.adj[i].push_back(v);
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)adj[top.first].size())
+        {
+            int i = adj[top.first][top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                frames.push_back({i, 0});
+            }
+        }
+        else
+        {
+            Deque.push_back(top.first);
+            frames.pop_back();
+        }
     }
-    return g;
 }
 
-// DFS traversal
-void Graph::DFSUtil(int v, vector<bool> &visited, stringstream &out)
+// DFS traversal over lists (adj or radj) using the caller's frame buffer
+void Graph::DFSUtil(const vector<vector<int>> &lists, int v, vector<bool> &visited, stringstream &out, vector<pair<int, int>> &frames)
 {
     visited[v] = true;
     out << v + 1 << " ";
-    for (int i : adj[v])
-        if (!visited[i])
-            DFSUtil(i, visited, out);
+    frames.push_back({v, 0});
+
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)lists[top.first].size())
+        {
+            int i = lists[top.first][top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                out << i + 1 << " ";
+                frames.push_back({i, 0});
+            }
+        }
+        else
+            frames.pop_back();
+    }
 }
 
-Graph *g = nullptr; // Global pointer to the graph object
+Graph *g = nullptr;       // Global pointer to the graph object
+bool dedupEdges = false; // Set by -d: every graph keeps a single copy of each edge
+
+// Protects g and everything behind it; the event loops parse and send outside it
+mutex graphMutex;
 
 // Print Strongly Connected Components
-string Graph::printSCCs()
+shared_ptr<const string> Graph::printSCCs()
 {
+    // Nothing changed since the last call: hand out the same bytes again
+    if (cached && cachedVersion == version)
+        return cached;
+
     deque<int> Deque;
+    vector<pair<int, int>> frames; // DFS frames, reused by every traversal below
     vector<bool> visited(V, false);
     stringstream result;
 
     // Fill vertices in stack according to their finishing times
     for (int i = 0; i < V; i++)
         if (!visited[i])
-            fillOrder(i, visited, Deque);
-
-    // Create a reversed graph
-    Graph gr = getTranspose();
+            fillOrder(i, visited, Deque, frames);
 
     // Mark all the vertices as not visited (For second DFS)
     fill(visited.begin(), visited.end(), false);
@@ -110,12 +261,14 @@ string Graph::printSCCs()
         Deque.pop_back();
         if (!visited[v])
         {
-            gr.DFSUtil(v, visited, result);
+            DFSUtil(radj, v, visited, result, frames);
             result << endl;
         }
     }
 
-    return result.str();
+    cached = make_shared<const string>(result.str());
+    cachedVersion = version;
+    return cached;
 }
 
 void handleClient(int client_fd)
@@ -190,9 +343,8 @@ void handleClient(int client_fd)
             return;
         }
 
-        // Delete the old graph and create a new one
-        delete g;
-        g = new Graph(n);
+        // Build the new graph before taking the lock, so the other loops only wait for the swap
+        Graph *created = new Graph(n, dedupEdges);
         cout << "Creating new graph with " << n << " vertices and " << m << " edges." << endl;
 
         // Parse and add edges
@@ -200,18 +352,32 @@ void handleClient(int client_fd)
         {
             int src = tokens[2 + 2 * i];
             int dest = tokens[3 + 2 * i];
-            g->addEdge(src - 1, dest - 1);
+            created->addEdge(src - 1, dest - 1);
         }
         cout << "Added edges." << endl;
+
+        Graph *old;
+        {
+            lock_guard<mutex> lock(graphMutex);
+            old = g;
+            g = created;
+        }
+        delete old;
         send(client_fd, "Created new graph\n", 18, 0);
     }
 
     else if (command == "Kosaraju")
     {
-        if (g)
+        // Usually the cached bytes; they stay valid after the lock is released
+        shared_ptr<const string> result;
         {
-            string result = g->printSCCs();
-            send(client_fd, result.c_str(), result.size(), 0);
+            lock_guard<mutex> lock(graphMutex);
+            if (g)
+                result = g->printSCCs();
+        }
+        if (result)
+        {
+            send(client_fd, result->c_str(), result->size(), 0);
             cout << "Sent SCCs to client_fd: " << client_fd << endl;
         }
         else
@@ -224,9 +390,15 @@ void handleClient(int client_fd)
     {
         int i, j;
         iss >> i >> j;
-        if (g)
+        bool found;
+        {
+            lock_guard<mutex> lock(graphMutex);
+            found = g != nullptr;
+            if (g)
+                g->addEdge(i - 1, j - 1);
+        }
+        if (found)
         {
-            g->addEdge(i - 1, j - 1);
             send(client_fd, "Edge added\n", 11, 0);
             cout << "Added edge from " << i << " to " << j << " for client_fd: " << client_fd << endl;
         }
@@ -240,9 +412,15 @@ void handleClient(int client_fd)
     {
         int i, j;
         iss >> i >> j;
-        if (g)
+        bool found;
+        {
+            lock_guard<mutex> lock(graphMutex);
+            found = g != nullptr;
+            if (g)
+                g->removeEdge(i - 1, j - 1);
+        }
+        if (found)
         {
-            g->removeEdge(i - 1, j - 1);
             send(client_fd, "Edge removed\n", 13, 0);
             cout << "Removed edge from " << i << " to " << j << " for client_fd: " << client_fd << endl;
         }
@@ -259,14 +437,15 @@ void handleClient(int client_fd)
     }
 }
 
-int main()
+// Open a listening socket on PORT. With reusePort every event loop binds its
+// own socket to the port, and the kernel spreads new connections among them.
+int openListener(bool reusePort)
 {
-    cout << "Server listening on port " << PORT << endl;
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0)
     {
         perror("socket");
-        return 1;
+        return -1;
     }
     cout << "Server socket created: " << server_fd << endl;
     int opt = 1;
@@ -274,9 +453,15 @@ int main()
     {
         perror("setsockopt");
         close(server_fd);
-        return 1;
+        return -1;
     }
     cout << "setsockopt for SO_REUSEADDR" << endl;
+    if (reusePort && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+    {
+        perror("setsockopt");
+        close(server_fd);
+        return -1;
+    }
     sockaddr_in address;
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
@@ -286,16 +471,25 @@ int main()
     {
         perror("bind");
         close(server_fd);
-        return 1;
+        return -1;
     }
     cout << "bind successful" << endl;
     if (listen(server_fd, 5) < 0)
     {
         perror("listen");
         close(server_fd);
-        return 1;
+        return -1;
     }
     cout << "listen successful" << endl;
+    return server_fd;
+}
+
+// One event loop: accepts on its own listening socket and serves the clients it accepted
+void *runLoop(void *arg)
+{
+    int server_fd = *(int *)arg;
+    delete (int *)arg;
+
     Reactor reactor;
     reactor.addFdToReactor(server_fd, [&](int fd)
                            {
@@ -316,5 +510,75 @@ int main()
     cout << "Reactor stopped" << endl;
 
     close(server_fd);
+    return nullptr;
+}
+
+// Whole decimal number in [0, INT_MAX]; anything else is refused
+bool parseCount(const char *text, int &count)
+{
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end || value < 0 || value > INT_MAX)
+        return false;
+    count = (int)value;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = 1;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        string flag = argv[arg];
+        if (flag == "-d")
+            dedupEdges = true;
+        else if (flag == "-l" && arg + 1 < argc && parseCount(argv[arg + 1], loops))
+            arg++;
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [-d] [-l loops]" << endl;
+            cerr << "  -d  drop parallel edges as they arrive instead of storing every copy" << endl;
+            cerr << "  -l  number of event loops, each on its own thread and socket; 0 for one per core" << endl;
+            return 1;
+        }
+    }
+    if (loops < 1)
+        loops = max(1u, thread::hardware_concurrency());
+
+    cout << "Server listening on port " << PORT << " with " << loops << " event loop(s)" << endl;
+
+    // Every socket is opened before any loop runs, so a port already in use fails at startup
+    vector<int> listeners;
+    for (int i = 0; i < loops; i++)
+    {
+        int server_fd = openListener(loops > 1);
+        if (server_fd < 0)
+        {
+            for (int fd : listeners)
+                close(fd);
+            return 1;
+        }
+        listeners.push_back(server_fd);
+    }
+
+    // The last loop runs on the main thread
+    vector<pthread_t> threads(loops - 1);
+    for (int i = 0; i < loops - 1; i++)
+    {
+        int *server_fd = new int(listeners[i]);
+        if (pthread_create(&threads[i], nullptr, runLoop, server_fd) != 0)
+        {
+            perror("pthread_create");
+            delete server_fd;
+            // The loops already started go down with the process; no socket is left open
+            for (int fd : listeners)
+                close(fd);
+            return 1;
+        }
+    }
+    runLoop(new int(listeners[loops - 1]));
+
+    for (pthread_t tid : threads)
+        pthread_join(tid, nullptr);
     return 0;
-}
\ No newline at end of file
+}
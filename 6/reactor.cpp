@@ -1,13 +1,21 @@
 #include "reactor.hpp"
 #include <iostream>
 #include <unistd.h>
-#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 
-Reactor::Reactor() : running(true) {}
+Reactor::Reactor(bool edgeTriggered) : edgeTriggered(edgeTriggered), events(64), running(true)
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0)
+        perror("epoll_create1");
+}
 
 Reactor::~Reactor()
 {
     stopReactor();
+    if (epollFd >= 0)
+        close(epollFd);
 }
 
 void *Reactor::startReactor()
@@ -17,21 +25,31 @@ void *Reactor::startReactor()
 
 int Reactor::addFdToReactor(int fd, reactorFunc func)
 {
-    struct pollfd pfd;
-    pfd.fd = fd;
-    pfd.events = POLLIN;
-    pollfds.push_back(pfd);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | (edgeTriggered ? EPOLLET : 0);
+    ev.data.fd = fd;
+
+    // Registering an fd again just replaces its callback
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0 &&
+        (errno != EEXIST || epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) < 0))
+    {
+        perror("epoll_ctl");
+        return -1;
+    }
+
+    if (fd >= (int)callbacks.size())
+        callbacks.resize(fd + 1);
     callbacks[fd] = func;
     return 0;
 }
 
 int Reactor::removeFdFromReactor(int fd)
 {
-    pollfds.erase(remove_if(pollfds.begin(), pollfds.end(),
-                            [fd](const struct pollfd &pfd)
-                            { return pfd.fd == fd; }),
-                  pollfds.end());
-    callbacks.erase(fd);
+    // A closed fd has already left the epoll set on its own
+    if (epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr) < 0 && errno != EBADF && errno != ENOENT)
+        perror("epoll_ctl");
+    if (fd < (int)callbacks.size())
+        callbacks[fd] = nullptr;
     return 0;
 }
 
@@ -43,36 +61,39 @@ int Reactor::stopReactor()
 }
 
 /**
- * Runs the reactor, polling for incoming events and executing the corresponding
+ * Runs the reactor, waiting for ready fds and executing the corresponding
  * callback functions.
  */
 void Reactor::run()
 {
     running = true;
-    
-    // Poll for incoming events
+
     while (running)
     {
-        cout << pollfds.size() << endl;
-        int ready = poll(pollfds.data(), pollfds.size(), 1000);
+        int ready = epoll_wait(epollFd, events.data(), (int)events.size(), 1000);
         if (ready < 0)
         {
-            perror("poll");
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
             break;
         }
 
-        // Execute callbacks for incoming events
-        for (const auto &pfd : pollfds)
+        // Hangups and errors go to the callback too, so it can see the failed read and clean up
+        for (int i = 0; i < ready; i++)
         {
-            if (pfd.revents & POLLIN)
+            int fd = events[i].data.fd;
+
+            // An earlier callback in this batch may have removed fd
+            if (fd < (int)callbacks.size() && callbacks[fd])
             {
-                // Check if callback function is registered for this fd
-                if (callbacks.find(pfd.fd) != callbacks.end())
-                {
-                    // Execute the callback function
-                    callbacks[pfd.fd](pfd.fd);
-                }
+                // Call a copy: the callback may register fds and grow the table under itself
+                reactorFunc func = callbacks[fd];
+                func(fd);
             }
         }
+
+        if (ready == (int)events.size())
+            events.resize(events.size() * 2);
     }
 }
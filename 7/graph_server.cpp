@@ -4,6 +4,12 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <numeric>
+#include <climits>
+#include <cctype>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <pthread.h>
@@ -11,158 +17,544 @@
 
 using namespace std;
 
+// One operation of a Batch command, with 0-based vertices
+struct EdgeOp
+{
+    bool add; // Add v -> w, or remove every copy of it
+    int v, w;
+};
+
+// Immutable copy of the adjacency at one graph version. Readers run SCCs on it
+// without the graph lock, and writers never touch it. Each chunk holds the
+// lists of CHUNK consecutive vertices and is shared with the next snapshot
+// unless one of those lists changes in between.
+class Snapshot
+{
+public:
+    static const int CHUNK = 256;
+    struct Chunk
+    {
+        vector<vector<int>> adj, radj;
+    };
+
+    int V = 0;
+    unsigned long version = 0; // Graph version the lists were copied at
+    vector<shared_ptr<const Chunk>> chunks;
+
+    const vector<int> &outEdges(int v) const { return chunks[v / CHUNK]->adj[v % CHUNK]; }
+    const vector<int> &inEdges(int v) const { return chunks[v / CHUNK]->radj[v % CHUNK]; }
+
+    // SCCs of this version. The first caller computes them; concurrent callers
+    // wait for it, and everyone shares the same bytes.
+    shared_ptr<const string> printSCCs() const;
+
+private:
+    mutable once_flag computed;
+    mutable shared_ptr<const string> result;
+
+    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames) const;
+    void DFSUtil(int v, vector<bool> &visited, stringstream &out, vector<pair<int, int>> &frames) const;
+};
+
 // Graph class to represent a directed graph using adjacency list representation
 class Graph
 {
-    int V;                   // Number of vertices
-    vector<vector<int>> adj; // Adjacency list
-
-    void fillOrder(int v, vector<bool> &visited, deque<int> &Deque);
-    void DFSUtil(int v, vector<bool> &visited, stringstream &out);
+    int V;                    // Number of vertices
+    vector<vector<int>> adj;  // Adjacency list
+    vector<vector<int>> radj; // Reverse adjacency list, kept in step with adj
+    vector<vector<int>> adjPos;  // adjPos[v][i]: index of the edge v -> adj[v][i] in radj[adj[v][i]]
+    vector<vector<int>> radjPos; // radjPos[w][j]: index of the edge radj[w][j] -> w in adj[radj[w][j]]
+
+    // Hash index over the out-edges of vertices with more than HUB_DEGREE of them:
+    // target -> slots in adj. Smaller lists are cheaper to scan.
+    static const size_t HUB_DEGREE = 32;
+    unordered_map<int, unordered_multimap<int, int>> hubIndex;
+    bool dedup; // Keep a single copy of every edge: addEdge ignores one already present
+
+    unsigned long version = 0;            // Bumped by every mutation
+    vector<char> dirty;                   // Per chunk: lists changed since the last snapshot
+    vector<int> dirtyChunks;              // The chunks marked in dirty
+    shared_ptr<const Snapshot> published; // Latest snapshot handed to readers
+
+    void touch(int v);
+    void unlinkEdge(int v, int i);
+    void indexHub(int v);
+    bool hasEdge(int v, int w);
 
 public:
-    Graph(int V);
+    Graph(int V, bool dedup = false);
     void addEdge(int v, int w);
     void removeEdge(int v, int w);
-    string printSCCs();
-    Graph getTranspose();
+    // Readers take this under the lock and use it after releasing it. Cheap
+    // when little changed: untouched chunks come from the previous snapshot.
+    shared_ptr<const Snapshot> snapshot();
+    int vertices() const { return V; }
+    // Apply every operation in order; the caller holds the lock for all of them
+    void applyBatch(const vector<EdgeOp> &ops);
 };
 
-Graph::Graph(int V)
+Graph::Graph(int V, bool dedup)
 {
     this->V = V;
+    this->dedup = dedup;
     adj.resize(V);
+    radj.resize(V);
+    adjPos.resize(V);
+    radjPos.resize(V);
+    dirty.assign((V + Snapshot::CHUNK - 1) / Snapshot::CHUNK, 0);
 }
 
 void Graph::addEdge(int v, int w)
 {
+    if (dedup && hasEdge(v, w))
+        return;
+    touch(v);
+    touch(w);
+
+    // Each edge records where its twin sits in the other list, so removal never searches radj
+    adjPos[v].push_back((int)radj[w].size());
+    radjPos[w].push_back((int)adj[v].size());
     adj[v].push_back(w);
+    radj[w].push_back(v);
+
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+        hub->second.emplace(w, (int)adj[v].size() - 1);
+    else if (adj[v].size() > HUB_DEGREE)
+        indexHub(v);
+    version++;
 }
 
 void Graph::removeEdge(int v, int w)
 {
-    adj[v].erase(remove(adj[v].begin(), adj[v].end(), w), adj[v].end());
+    touch(v);
+    touch(w);
+
+    // Slots in adj[v] holding a copy of the edge: a hash lookup for hubs, a short scan otherwise
+    vector<int> slots;
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+    {
+        auto range = hub->second.equal_range(w);
+        for (auto it = range.first; it != range.second; ++it)
+            slots.push_back(it->second);
+        hub->second.erase(range.first, range.second);
+    }
+    else
+    {
+        for (int i = 0; i < (int)adj[v].size(); i++)
+            if (adj[v][i] == w)
+                slots.push_back(i);
+    }
+
+    // Highest slot first, so the edge moved into a freed slot is never another copy
+    sort(slots.begin(), slots.end(), greater<int>());
+    for (int i : slots)
+        unlinkEdge(v, i);
+    if (hub != hubIndex.end() && adj[v].size() < HUB_DEGREE / 2)
+        hubIndex.erase(hub);
+    version++;
 }
 
-void Graph::fillOrder(int v, vector<bool> &visited, deque<int> &Deque)
+void Graph::applyBatch(const vector<EdgeOp> &ops)
 {
-    visited[v] = true;
-    for (int i : adj[v])
-        if (!visited[i])
-            fillOrder(i, visited, Deque);
-    Deque.push_back(v);
+    for (const EdgeOp &op : ops)
+    {
+        if (op.add)
+            addEdge(op.v, op.w);
+        else
+            removeEdge(op.v, op.w);
+    }
 }
 
-Graph Graph::getTranspose()
+// Remove the edge in slot i of adj[v] and its twin in radj, each by moving the
+// last entry of its list into the hole. O(1) apart from a hub's multiplicity.
+void Graph::unlinkEdge(int v, int i)
 {
-    Graph g(V);
-    for (int v = 0; v < V; v++)
+    int w = adj[v][i], j = adjPos[v][i];
+
+    int last = (int)radj[w].size() - 1;
+    if (j != last)
+    {
+        int u = radj[w][last], k = radjPos[w][last];
+        radj[w][j] = u;
+        radjPos[w][j] = k;
+        adjPos[u][k] = j;
+    }
+    radj[w].pop_back();
+    radjPos[w].pop_back();
+
+    last = (int)adj[v].size() - 1;
+    if (i != last)
     {
-        for (int i : adj[v])
-            g.adj[i].push_back(v);
+        int x = adj[v][last], k = adjPos[v][last];
+        adj[v][i] = x;
+        adjPos[v][i] = k;
+        radjPos[x][k] = i;
+
+        auto hub = hubIndex.find(v);
+        if (hub != hubIndex.end())
+        {
+            auto range = hub->second.equal_range(x);
+            for (auto it = range.first; it != range.second; ++it)
+                if (it->second == last)
+                {
+                    it->second = i;
+                    break;
+                }
+        }
     }
-    return g;
+    adj[v].pop_back();
+    adjPos[v].pop_back();
 }
 
-void Graph::DFSUtil(int v, vector<bool> &visited, stringstream &out)
+// Start indexing the out-edges of v, which just outgrew a linear scan
+void Graph::indexHub(int v)
 {
-    visited[v] = true;
-    out << v + 1 << " ";
-    for (int i : adj[v])
-        if (!visited[i])
-            DFSUtil(i, visited, out);
+    unordered_multimap<int, int> &index = hubIndex[v];
+    index.reserve(adj[v].size() * 2);
+    for (int i = 0; i < (int)adj[v].size(); i++)
+        index.emplace(adj[v][i], i);
+}
+
+// Whether v -> w is present, through the hub index or a scan of a short list
+bool Graph::hasEdge(int v, int w)
+{
+    auto hub = hubIndex.find(v);
+    if (hub != hubIndex.end())
+        return hub->second.count(w) > 0;
+    return find(adj[v].begin(), adj[v].end(), w) != adj[v].end();
 }
 
-string Graph::printSCCs()
+shared_ptr<const Snapshot> Graph::snapshot()
 {
-    deque<int> Deque;
-    vector<bool> visited(V, false);
-    stringstream result;
+    if (published && published->version == version)
+        return published;
+
+    // Start from the previous snapshot's chunks and replace only the changed ones
+    shared_ptr<Snapshot> next = make_shared<Snapshot>();
+    next->V = V;
+    next->version = version;
+    if (published)
+        next->chunks = published->chunks;
+    else
+    {
+        next->chunks.resize(dirty.size());
+        dirtyChunks.resize(dirty.size());
+        iota(dirtyChunks.begin(), dirtyChunks.end(), 0);
+    }
+
+    for (int c : dirtyChunks)
+    {
+        shared_ptr<Snapshot::Chunk> chunk = make_shared<Snapshot::Chunk>();
+        int first = c * Snapshot::CHUNK, last = min(V, first + Snapshot::CHUNK);
+        chunk->adj.assign(adj.begin() + first, adj.begin() + last);
+        chunk->radj.assign(radj.begin() + first, radj.begin() + last);
+        next->chunks[c] = chunk;
+        dirty[c] = 0;
+    }
+    dirtyChunks.clear();
+
+    published = next;
+    return published;
+}
+
+// Note that v's lists changed, so the next snapshot copies its chunk
+void Graph::touch(int v)
+{
+    int c = v / Snapshot::CHUNK;
+    if (!dirty[c])
+    {
+        dirty[c] = 1;
+        dirtyChunks.push_back(c);
+    }
+}
 
-    for (int i = 0; i < V; i++)
-        if (!visited[i])
-            fillOrder(i, visited, Deque);
+void Snapshot::fillOrder(int v, vector<bool> &visited, deque<int> &Deque, vector<pair<int, int>> &frames) const
+{
+    visited[v] = true;
+    frames.push_back({v, 0});
 
-    Graph gr = getTranspose();
+    while (!frames.empty())
+    {
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)outEdges(top.first).size())
+        {
+            int i = outEdges(top.first)[top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                frames.push_back({i, 0});
+            }
+        }
+        else
+        {
+            Deque.push_back(top.first);
+            frames.pop_back();
+        }
+    }
+}
 
-    fill(visited.begin(), visited.end(), false);
+void Snapshot::DFSUtil(int v, vector<bool> &visited, stringstream &out, vector<pair<int, int>> &frames) const
+{
+    visited[v] = true;
+    out << v + 1 << " ";
+    frames.push_back({v, 0});
 
-    while (!Deque.empty())
+    while (!frames.empty())
     {
-        int v = Deque.back();
-        Deque.pop_back();
-        if (!visited[v])
+        pair<int, int> &top = frames.back();
+        if (top.second < (int)inEdges(top.first).size())
         {
-            gr.DFSUtil(v, visited, result);
-            result << endl;
+            int i = inEdges(top.first)[top.second++];
+            if (!visited[i])
+            {
+                visited[i] = true;
+                out << i + 1 << " ";
+                frames.push_back({i, 0});
+            }
         }
+        else
+            frames.pop_back();
     }
+}
+
+shared_ptr<const string> Snapshot::printSCCs() const
+{
+    call_once(computed, [this]()
+              {
+        deque<int> Deque;
+        vector<pair<int, int>> frames; // DFS frames, reused by every traversal below
+        vector<bool> visited(V, false);
+        stringstream text;
+
+        for (int i = 0; i < V; i++)
+            if (!visited[i])
+                fillOrder(i, visited, Deque, frames);
+
+        fill(visited.begin(), visited.end(), false);
+
+        while (!Deque.empty())
+        {
+            int v = Deque.back();
+            Deque.pop_back();
+            if (!visited[v])
+            {
+                DFSUtil(v, visited, text, frames);
+                text << endl;
+            }
+        }
 
-    return result.str();
+        result = make_shared<const string>(text.str()); });
+    return result;
 }
 
 // Global pointer to the graph object
 Graph *g = nullptr;
 
+// Set by -d: every graph keeps a single copy of each edge
+bool dedupEdges = false;
+
 // Mutex to protect the shared graph object
 mutex graphMutex;
 
+// Input side of one client connection. What recv returns stays buffered across
+// commands, so a command split over several reads, several commands in one
+// read and payloads of any length all parse the same way.
+class ClientReader
+{
+public:
+    explicit ClientReader(int fd) : fd(fd) {}
+
+    static const size_t MAX_LINE = 1 << 16; // Longer lines and tokens are refused
+
+    // Next line without its newline; false once the client is gone. A line
+    // longer than MAX_LINE is dropped as it arrives and reported as tooLong.
+    bool readLine(string &line, bool &tooLong)
+    {
+        tooLong = false;
+        size_t newline, scanned = 0; // scanned: bytes after pos known to hold no newline
+        while ((newline = in.find('\n', pos + scanned)) == string::npos)
+        {
+            if (in.size() - pos > MAX_LINE)
+            {
+                tooLong = true;
+                pos = in.size();
+            }
+            scanned = in.size() - pos;
+            if (!fill())
+                return false;
+        }
+        if (tooLong)
+            line.clear();
+        else
+            line.assign(in, pos, newline - pos);
+        pos = newline + 1;
+        return true;
+    }
+
+    // Next whitespace-separated token: first from rest, what followed the
+    // command on its line, then from further input. A token at the very end of
+    // the input may still be cut off, so it counts once whitespace follows it.
+    // False once the client is gone or for a token longer than MAX_LINE.
+    bool readToken(istringstream &rest, string &token)
+    {
+        if (rest >> token)
+            return true;
+        while (true)
+        {
+            while (pos < in.size() && isspace((unsigned char)in[pos]))
+                pos++;
+            size_t end = pos;
+            while (end < in.size() && !isspace((unsigned char)in[end]))
+                end++;
+            if (end < in.size())
+            {
+                token.assign(in, pos, end - pos);
+                pos = end;
+                return true;
+            }
+            if (end - pos > MAX_LINE || !fill())
+                return false;
+        }
+    }
+
+private:
+    int fd;
+    string in; // in[pos..] is received but not parsed yet
+    size_t pos = 0;
+
+    bool fill()
+    {
+        in.erase(0, pos);
+        pos = 0;
+        char chunk[1 << 16];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 1)
+            return false;
+        in.append(chunk, n);
+        return true;
+    }
+};
+
+// A 1-based vertex number as a 0-based index; false if token isn't one
+bool parseVertex(const string &token, int &vertex)
+{
+    char *end;
+    long value = strtol(token.c_str(), &end, 10);
+    if (token.empty() || *end || value < 1 || value > INT_MAX)
+        return false;
+    vertex = (int)value - 1;
+    return true;
+}
+
+// Collect the count operations of a Batch command, "+ i j" to add an edge and
+// "- i j" to remove one, from what followed the command on its line and then
+// from the client's further input. False if an operation is malformed or the
+// client leaves first.
+bool readBatch(ClientReader &reader, istringstream &iss, int count, vector<EdgeOp> &ops)
+{
+    string token;
+    for (int i = 0; i < count; i++)
+    {
+        EdgeOp op = {};
+        if (!reader.readToken(iss, token) || (token != "+" && token != "-"))
+            return false;
+        op.add = token == "+";
+        if (!reader.readToken(iss, token) || !parseVertex(token, op.v) ||
+            !reader.readToken(iss, token) || !parseVertex(token, op.w))
+            return false;
+        ops.push_back(op);
+    }
+    return true;
+}
+
 // Function to handle client requests
 void *handleClient(void *arg)
 {
     int clientSocket = *(int *)arg;
     delete (int *)arg;
 
-    char buffer[1024];
+    ClientReader reader(clientSocket);
     string line;
 
     string instructions = "Please insert one of the following commands:\n"
-                          "Newgraph <n> <m> - Create a new graph with n vertices and m edges\n"
+                          "Newgraph <n> <m> - Create a new graph with n vertices and m edges, followed by m pairs \"i j\"\n"
                           "Kosaraju - Print SCCs of the graph\n"
                           "Newedge <i> <j> - Add edge from vertex i to vertex j\n"
-                          "Removeedge <i> <j> - Remove edge from vertex i to vertex j\n";
+                          "Removeedge <i> <j> - Remove edge from vertex i to vertex j\n"
+                          "Batch <k> - Apply k operations at once, each \"+ i j\" (add) or \"- i j\" (remove)\n";
     send(clientSocket, instructions.c_str(), instructions.size(), 0);
 
-    while (true)
+    // One command per line; a pipelining client gets the replies in order
+    bool tooLong;
+    while (reader.readLine(line, tooLong))
     {
-        ssize_t bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-        if (bytesReceived < 1)
+        if (tooLong)
         {
-            close(clientSocket);
-            return nullptr;
+            send(clientSocket, "Invalid command\n", 16, 0);
+            continue;
         }
-        buffer[bytesReceived] = '\0';
-        line = buffer;
 
         istringstream iss(line);
         string command;
-        iss >> command;
+        if (!(iss >> command))
+            continue; // Blank line
 
         if (command == "Newgraph")
         {
-            int n, m;
+            int n = 0, m = -1;
             iss >> n >> m;
-            lock_guard<mutex> lock(graphMutex);
-            delete g;
-            g = new Graph(n);
-            for (int i = 0; i < m; ++i)
+            if (n < 1 || m < 0)
+            {
+                send(clientSocket, "Invalid graph\n", 14, 0);
+                continue;
+            }
+
+            // The edges may follow on this line or on any number of later ones.
+            // The graph is built privately while they arrive, and only the swap
+            // takes the lock, so other clients are not held up by a slow sender.
+            Graph *created = new Graph(n, dedupEdges);
+            bool valid = true;
+            string token;
+            int i = 0;
+            for (; i < m; ++i)
             {
-                cout << "insert edge number " << i << endl;
                 int src, dest;
-                recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-                istringstream edgeStream(buffer);
-                edgeStream >> src >> dest;
-                g->addEdge(src - 1, dest - 1);
+                if (!reader.readToken(iss, token) || !parseVertex(token, src) ||
+                    !reader.readToken(iss, token) || !parseVertex(token, dest))
+                    break;
+                // A vertex outside the new graph spoils it, but the edges are still read to the end
+                valid = valid && src < n && dest < n;
+                if (valid)
+                    created->addEdge(src, dest);
+            }
+            if (i < m || !valid)
+            {
+                delete created;
+                send(clientSocket, "Invalid graph\n", 14, 0);
+                continue;
             }
+            {
+                lock_guard<mutex> lock(graphMutex);
+                swap(g, created);
+            }
+            delete created; // The old graph
             send(clientSocket, "Created new graph\n", 18, 0);
         }
         else if (command == "Kosaraju")
         {
-            lock_guard<mutex> lock(graphMutex);
-            if (g)
+            // Only taking the snapshot needs the lock; writers go on while the SCCs run
+            shared_ptr<const Snapshot> snapshot;
+            {
+                lock_guard<mutex> lock(graphMutex);
+                if (g)
+                    snapshot = g->snapshot();
+            }
+            if (snapshot)
             {
-                string result = g->printSCCs();
-                send(clientSocket, result.c_str(), result.size(), 0);
+                shared_ptr<const string> result = snapshot->printSCCs();
+                send(clientSocket, result->c_str(), result->size(), 0);
             }
             else
             {
@@ -171,33 +563,73 @@ void *handleClient(void *arg)
         }
         else if (command == "Newedge")
         {
-            int i, j;
-            iss >> i >> j;
+            string first, second;
+            int i = 0, j = 0;
+            bool valid = iss >> first >> second && parseVertex(first, i) && parseVertex(second, j);
             lock_guard<mutex> lock(graphMutex);
-            if (g)
+            if (!g)
             {
-                g->addEdge(i - 1, j - 1);
-                send(clientSocket, "Edge added\n", 11, 0);
+                send(clientSocket, "No graph created yet.\n", 22, 0);
+            }
+            else if (!valid || i >= g->vertices() || j >= g->vertices())
+            {
+                send(clientSocket, "Invalid vertex\n", 15, 0);
             }
             else
             {
-                send(clientSocket, "No graph created yet.\n", 22, 0);
+                g->addEdge(i, j);
+                send(clientSocket, "Edge added\n", 11, 0);
             }
         }
         else if (command == "Removeedge")
         {
-            int i, j;
-            iss >> i >> j;
+            string first, second;
+            int i = 0, j = 0;
+            bool valid = iss >> first >> second && parseVertex(first, i) && parseVertex(second, j);
             lock_guard<mutex> lock(graphMutex);
-            if (g)
+            if (!g)
             {
-                g->removeEdge(i - 1, j - 1);
-                send(clientSocket, "Edge removed\n", 13, 0);
+                send(clientSocket, "No graph created yet.\n", 22, 0);
+            }
+            else if (!valid || i >= g->vertices() || j >= g->vertices())
+            {
+                send(clientSocket, "Invalid vertex\n", 15, 0);
             }
             else
+            {
+                g->removeEdge(i, j);
+                send(clientSocket, "Edge removed\n", 13, 0);
+            }
+        }
+        else if (command == "Batch")
+        {
+            int count = 0;
+            iss >> count;
+            vector<EdgeOp> ops;
+            ops.reserve(min(max(count, 0), 1 << 20));
+            if (count < 1 || !readBatch(reader, iss, count, ops))
+            {
+                send(clientSocket, "Invalid batch\n", 14, 0);
+                continue;
+            }
+
+            // Checked up front, so a batch is applied whole or not at all
+            lock_guard<mutex> lock(graphMutex);
+            if (!g)
             {
                 send(clientSocket, "No graph created yet.\n", 22, 0);
+                continue;
+            }
+            bool valid = true;
+            for (const EdgeOp &op : ops)
+                valid = valid && op.v < g->vertices() && op.w < g->vertices();
+            if (!valid)
+            {
+                send(clientSocket, "Invalid batch\n", 14, 0);
+                continue;
             }
+            g->applyBatch(ops);
+            send(clientSocket, "Batch applied\n", 14, 0);
         }
         else
         {
@@ -209,8 +641,11 @@ void *handleClient(void *arg)
     return nullptr;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+    // -d: drop parallel edges as they arrive instead of storing every copy
+    dedupEdges = argc > 1 && string(argv[1]) == "-d";
+
     int serverSocket, clientSocket;
     sockaddr_in serverAddr, clientAddr;
     socklen_t clientAddrSize;
@@ -1,47 +1,181 @@
 #include "proactor.hpp"
 #include <stdexcept>
+#include <iostream>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <unistd.h>
 
-Proactor::Proactor() {}
+const int Proactor::EXTRA_IDLE_SECONDS; // Bound to a reference by std::chrono::seconds
 
-Proactor::~Proactor() {}
+Proactor::Proactor(int workerCount, int maxQueued) : maxQueued(maxQueued)
+{
+    if (workerCount <= 0)
+        workerCount = DEFAULT_WORKERS_PER_CORE * std::max(1u, std::thread::hardware_concurrency());
+    for (int id = 0; id < workerCount; id++)
+        workers.emplace_back(new Worker());
+
+    // Workers steal from each other, so every queue must exist before the first one starts
+    for (int id = 0; id < workerCount; id++)
+    {
+        auto *arg = new std::pair<Proactor *, int>(this, id);
+        if (pthread_create(&workers[id]->tid, nullptr, workerStart, arg) != 0)
+        {
+            delete arg;
+            {
+                std::lock_guard<std::mutex> lock(idleMutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (int started = 0; started < id; started++)
+                pthread_join(workers[started]->tid, nullptr);
+            throw std::runtime_error("Failed to create worker thread");
+        }
+    }
+}
+
+Proactor::~Proactor()
+{
+    stopProactor();
+}
 
 // Thread starter function
-void *threadStart(void *arg)
+void *Proactor::workerStart(void *arg)
 {
-    auto *pair = static_cast<std::pair<int, proactorFunc> *>(arg);
-    int sockfd = pair->first;
-    proactorFunc func = pair->second;
-    func(sockfd);
-    delete pair; // Free the allocated memory
+    auto *start = static_cast<std::pair<Proactor *, int> *>(arg);
+    Proactor *proactor = start->first;
+    int id = start->second;
+    delete start;
+    proactor->workerLoop(id);
     return nullptr;
 }
 
-// Starts a new proactor and returns the proactor thread
-pthread_t Proactor::startProactor(int sockfd, proactorFunc threadFunc)
+// Oldest task of the worker's own queue, else the oldest one found in another queue
+bool Proactor::takeTask(int id, Task &task)
+{
+    int count = (int)workers.size();
+    for (int k = 0; k < count; k++)
+    {
+        Worker &worker = *workers[(id + k) % count];
+        std::lock_guard<std::mutex> lock(worker.m);
+        if (!worker.tasks.empty())
+        {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Proactor::workerLoop(int id)
+{
+    bool extra = id >= (int)workers.size();
+    while (true)
+    {
+        Task task;
+        if (takeTask(id, task))
+        {
+            task.func(task.sockfd); // Execute the function with the socket descriptor
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex);
+        auto ready = [&]
+        { return stopping || queued > 0; };
+        idle++;
+        bool woken = true;
+        if (extra)
+            woken = wake.wait_for(lock, std::chrono::seconds(EXTRA_IDLE_SECONDS), ready);
+        else
+            wake.wait(lock, ready);
+        idle--;
+
+        // Core workers stay for the whole run; an extra leaves once it has nothing to do
+        if (stopping || !woken)
+        {
+            if (extra && --extras == 0)
+                extrasDone.notify_all();
+            return;
+        }
+    }
+}
+
+// Starts a detached extra worker; it is already counted in extras
+void Proactor::startExtra(int id)
 {
     pthread_t tid;
-    auto *pair = new std::pair<int, proactorFunc>(sockfd, threadFunc);
-    if (pthread_create(&tid, nullptr, threadStart, pair) != 0)
+    auto *arg = new std::pair<Proactor *, int>(this, id);
+    if (pthread_create(&tid, nullptr, workerStart, arg) != 0)
     {
-        delete pair; // Cleanup in case of error
-        throw std::runtime_error("Failed to create thread");
+        // The socket stays queued for the next worker that frees up
+        delete arg;
+        std::lock_guard<std::mutex> lock(idleMutex);
+        if (--extras == 0)
+            extrasDone.notify_all();
+        return;
     }
-    proactorMap[tid] = threadFunc;
-    return tid;
+    pthread_detach(tid);
 }
 
-// Stops the proactor by thread id
-int Proactor::stopProactor(pthread_t tid)
+// Queues a socket for the pool
+void Proactor::startProactor(int sockfd, proactorFunc threadFunc)
 {
-    if (proactorMap.find(tid) != proactorMap.end())
+    // Bounded, so a flood of clients costs a rejected connection and not unbounded memory
+    if (queued >= maxQueued)
+        throw std::runtime_error("Proactor queue is full");
+
+    Worker &worker = *workers[nextWorker++ % workers.size()];
     {
-        if (pthread_cancel(tid) != 0)
+        std::lock_guard<std::mutex> lock(worker.m);
+        worker.tasks.push_back(Task{sockfd, threadFunc});
+    }
+    int extraId = -1;
+    {
+        // Counted under idleMutex, so a worker about to sleep can't miss it.
+        // A session holds its worker until the client leaves, so a task no
+        // idle worker will take gets a worker of its own, while extras remain.
+        std::lock_guard<std::mutex> lock(idleMutex);
+        queued++;
+        if (!stopping && queued > idle && extras < MAX_EXTRA_WORKERS)
         {
-            return -1; // Failed to cancel the thread
+            extras++;
+            extraId = (int)workers.size() + nextExtra++;
         }
-        pthread_join(tid, nullptr); // Wait for the thread to finish
-        proactorMap.erase(tid);
-        return 0; // Success
     }
-    return -1; // Thread not found
+    wake.notify_one();
+    if (extraId >= 0)
+        startExtra(extraId);
+}
+
+// Stops the pool
+int Proactor::stopProactor()
+{
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        if (stopping)
+            return -1; // Already stopped
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &worker : workers)
+        pthread_join(worker->tid, nullptr); // Wait for the current task to finish
+    {
+        // Extras are detached; wait for the last one to leave its loop
+        std::unique_lock<std::mutex> lock(idleMutex);
+        extrasDone.wait(lock, [&]
+                        { return extras == 0; });
+    }
+
+    // Nobody will serve the clients still waiting
+    for (auto &worker : workers)
+    {
+        for (Task &task : worker->tasks)
+            close(task.sockfd);
+        worker->tasks.clear();
+    }
+    queued = 0;
+    return 0;
 }
@@ -1,61 +1,190 @@
 #include "proactor.hpp"
 #include <stdexcept>
 #include <iostream>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <unistd.h>
 
-Proactor::Proactor() {}
+const int Proactor::EXTRA_IDLE_SECONDS; // Bound to a reference by chrono::seconds
 
-Proactor::~Proactor() {}
+Proactor::Proactor(int workerCount, int maxQueued) : maxQueued(maxQueued)
+{
+    if (workerCount <= 0)
+        workerCount = DEFAULT_WORKERS_PER_CORE * max(1u, thread::hardware_concurrency());
+    for (int id = 0; id < workerCount; id++)
+        workers.emplace_back(new Worker());
+
+    // Workers steal from each other, so every queue must exist before the first one starts
+    for (int id = 0; id < workerCount; id++)
+    {
+        auto *arg = new pair<Proactor *, int>(this, id);
+        if (pthread_create(&workers[id]->tid, nullptr, workerStart, arg) != 0)
+        {
+            delete arg;
+            {
+                lock_guard<mutex> lock(idleMutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (int started = 0; started < id; started++)
+                pthread_join(workers[started]->tid, nullptr);
+            std::cerr << "Failed to create worker thread " << id << std::endl;
+            throw runtime_error("Failed to create worker thread");
+        }
+    }
+    std::cout << "Proactor started with " << workerCount << " workers" << std::endl;
+}
+
+Proactor::~Proactor()
+{
+    stopProactor();
+}
 
 // Thread starter function
-void *threadStart(void *arg)
-{
-    // Unpack the argument pair (socket file descriptor and the function to handle it)
-    auto *pair = static_cast<std::pair<int, proactorFunc> *>(arg);
-    int sockfd = pair->first;
-    proactorFunc func = pair->second;
-    std::cout << "Thread started for socket: " << sockfd << std::endl;
-    func(sockfd); // Execute the function with the socket descriptor
-    delete pair;  // Free the allocated memory for the argument pair
-    std::cout << "Thread finished for socket: " << sockfd << std::endl;
+void *Proactor::workerStart(void *arg)
+{
+    auto *start = static_cast<pair<Proactor *, int> *>(arg);
+    Proactor *proactor = start->first;
+    int id = start->second;
+    delete start;
+    proactor->workerLoop(id);
     return nullptr;
 }
 
-// Starts a new proactor and returns the proactor thread
-pthread_t Proactor::startProactor(int sockfd, proactorFunc threadFunc)
+// Oldest task of the worker's own queue, else the oldest one found in another queue
+bool Proactor::takeTask(int id, Task &task)
+{
+    int count = (int)workers.size();
+    for (int k = 0; k < count; k++)
+    {
+        Worker &worker = *workers[(id + k) % count];
+        lock_guard<mutex> lock(worker.m);
+        if (!worker.tasks.empty())
+        {
+            task = move(worker.tasks.front());
+            worker.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Proactor::workerLoop(int id)
+{
+    bool extra = id >= (int)workers.size();
+    while (true)
+    {
+        Task task;
+        if (takeTask(id, task))
+        {
+            std::cout << "Worker " << id << " serving socket: " << task.sockfd << std::endl;
+            task.func(task.sockfd); // Execute the function with the socket descriptor
+            std::cout << "Worker " << id << " finished socket: " << task.sockfd << std::endl;
+            continue;
+        }
+
+        unique_lock<mutex> lock(idleMutex);
+        auto ready = [&]
+        { return stopping || queued > 0; };
+        idle++;
+        bool woken = true;
+        if (extra)
+            woken = wake.wait_for(lock, chrono::seconds(EXTRA_IDLE_SECONDS), ready);
+        else
+            wake.wait(lock, ready);
+        idle--;
+
+        // Core workers stay for the whole run; an extra leaves once it has nothing to do
+        if (stopping || !woken)
+        {
+            if (extra && --extras == 0)
+                extrasDone.notify_all();
+            return;
+        }
+    }
+}
+
+// Starts a detached extra worker; it is already counted in extras
+void Proactor::startExtra(int id)
 {
     pthread_t tid;
-    // Create a pair of the socket descriptor and the function to handle it
-    auto *pair = new std::pair<int, proactorFunc>(sockfd, threadFunc);
-    // Create a new thread to run the threadStart function
-    if (pthread_create(&tid, nullptr, threadStart, pair) != 0)
+    auto *arg = new pair<Proactor *, int>(this, id);
+    if (pthread_create(&tid, nullptr, workerStart, arg) != 0)
     {
-        delete pair; // Cleanup in case of error
-        std::cerr << "Failed to create thread for socket: " << sockfd << std::endl;
-        throw std::runtime_error("Failed to create thread");
+        // The socket stays queued for the next worker that frees up
+        delete arg;
+        std::cerr << "Failed to create extra worker thread " << id << std::endl;
+        lock_guard<mutex> lock(idleMutex);
+        if (--extras == 0)
+            extrasDone.notify_all();
+        return;
     }
-    proactorMap[tid] = threadFunc; // Store the thread function in the map
-    std::cout << "Thread created with ID: " << tid << " for socket: " << sockfd << std::endl;
-    return tid; // Return the thread ID
+    pthread_detach(tid);
 }
 
-// Stops the proactor by thread id
-int Proactor::stopProactor(pthread_t tid)
+// Queues a socket for the pool
+void Proactor::startProactor(int sockfd, proactorFunc threadFunc)
 {
-    // Check if the thread ID exists in the map
-    if (proactorMap.find(tid) != proactorMap.end())
+    // Bounded, so a flood of clients costs a rejected connection and not unbounded memory
+    if (queued >= maxQueued)
+    {
+        std::cerr << "Proactor queue full, rejecting socket: " << sockfd << std::endl;
+        throw runtime_error("Proactor queue is full");
+    }
+
+    Worker &worker = *workers[nextWorker++ % workers.size()];
+    {
+        lock_guard<mutex> lock(worker.m);
+        worker.tasks.push_back(Task{sockfd, threadFunc});
+    }
+    int extraId = -1;
     {
-        std::cout << "Stopping thread with ID: " << tid << std::endl;
-        // Attempt to cancel the thread
-        if (pthread_cancel(tid) != 0)
+        // Counted under idleMutex, so a worker about to sleep can't miss it.
+        // A session holds its worker until the client leaves, so a task no
+        // idle worker will take gets a worker of its own, while extras remain.
+        lock_guard<mutex> lock(idleMutex);
+        queued++;
+        if (!stopping && queued > idle && extras < MAX_EXTRA_WORKERS)
         {
-            std::cerr << "Failed to cancel thread with ID: " << tid << std::endl;
-            return -1; // Failed to cancel the thread
+            extras++;
+            extraId = (int)workers.size() + nextExtra++;
         }
-        pthread_join(tid, nullptr); // Wait for the thread to finish
-        proactorMap.erase(tid);     // Remove the thread from the map
-        std::cout << "Thread with ID: " << tid << " has been stopped and removed" << std::endl;
-        return 0; // Success
     }
-    std::cerr << "Thread with ID: " << tid << " not found" << std::endl;
-    return -1; // Thread not found
+    wake.notify_one();
+    if (extraId >= 0)
+        startExtra(extraId);
+}
+
+// Stops the pool
+int Proactor::stopProactor()
+{
+    {
+        lock_guard<mutex> lock(idleMutex);
+        if (stopping)
+            return -1; // Already stopped
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &worker : workers)
+        pthread_join(worker->tid, nullptr); // Wait for the current task to finish
+    {
+        // Extras are detached; wait for the last one to leave its loop
+        unique_lock<mutex> lock(idleMutex);
+        extrasDone.wait(lock, [&]
+                        { return extras == 0; });
+    }
+
+    // Nobody will serve the clients still waiting
+    for (auto &worker : workers)
+    {
+        for (Task &task : worker->tasks)
+            close(task.sockfd);
+        worker->tasks.clear();
+    }
+    queued = 0;
+    std::cout << "Proactor stopped" << std::endl;
+    return 0;
 }